@@ -1,21 +1,92 @@
 #include <assert.h>
 #include <complex.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <gtk/gtk.h>
 #include <libavformat/avformat.h>
 #include <magic.h>
 #include <math.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <raylib.h>
+#include <rlgl.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "raven_shm.h"
+
 #define ARRAY_LEN(xs) sizeof(xs) / sizeof(xs[0])
 #define N             (1 << 13)
 #define pi            3.14159265358979323846f
 
+/**************************************************
+ * @ANALYSIS CONSTANTS
+ **************************************************/
+
+#define BANDS_MAX           128     // upper bound on visualized log-spaced bands
+#define BAND_FREQ_MIN       20.0f   // lowest band edge (Hz)
+#define BAND_STEP           1.06f   // ratio between neighbouring band edges
+#define ANALYSIS_RING_SLOTS 64      // frames kept in the audio -> render channel
+#define ANALYSIS_HOP        512     // stream frames between published analysis frames
+#define DECIM_TAPS          32      // FIR length of one 2:1 polyphase stage
+#define DECIM_PHASE_TAPS    (DECIM_TAPS / 2)
+#define DECIM_STAGES_MAX    3       // 2x, 4x, 8x
+#define DECIM_CROSSOVER_HZ  250.0f  // bands below this come from the decimated FFT
+#define DECIM_ALIGN_HOPS    (7 * (N / 2) / ANALYSIS_HOP + 1) // longest hold-back, 8x at full n
+#define FLUX_HISTORY        128     // hops in the adaptive onset threshold window (~1.5 s)
+#define BEAT_TIMES          8       // recent beats used for inter-onset intervals
+#define TEMPO_MIN_BPM       60
+#define TEMPO_MAX_BPM       180
+#define TARGET_FPS          60
+#define IDLE_FPS            15            // unfocused but still playing
+#define IDLE_POLL_SECONDS   (1.0 / 60.0) // input/stream polling when nothing is drawn
+#define UI_KEY_MAX          512           // bytes of input a retained panel can be keyed on
+#define PCM_RING_SECONDS    2             // burst buffer between the PCM reader and playback
+#define PCM_CHUNK_FRAMES    1024          // frames per stream update at 44.1 kHz, scaled by rate
+#define MAP_AHEAD_SECONDS   2             // mapped audio kept MADV_WILLNEED ahead of playback
+#define SEEK_STEP_SECONDS   5.0f          // LEFT / RIGHT seek distance
+#define GEOM_VERTS_MAX      16384         // vertices one visualization frame may emit
+#define GEOM_BATCHES_MAX    1024          // runs of same-mode primitives per frame
+#define GEOM_CIRCLE_SEGS    36            // matches raylib's DrawCircle()
+#define GEOM_SUBMIT_CHUNK   3072          // vertices per rlBegin(), a multiple of 2 and 3
+#define LATENCY_PERIODS     3             // device periods assumed queued (@LATENCY COMPENSATION)
+#define LATENCY_BURST_GAP   0.002         // s between callback() bursts of two device periods
+#define LATENCY_EXTRAPOLATE 0.1           // s the audible position may run past the newest frame
+#define AV_OFFSET_STEP_MS   5             // [ and ] adjust the manual A/V offset by this much
+#define LUFS_MOMENTARY_SUBS 4             // 100 ms sub-blocks in the momentary window
+#define LUFS_SHORT_SUBS     30            // ... and in the short-term window
+#define LUFS_HIST_BINS      1000          // integrated loudness histogram, -70 to +30 LUFS
+#define LUFS_HIST_STEP      0.1           // LU per histogram bin
+#define LUFS_ABSOLUTE_GATE  -70.0         // blocks below this never count towards integrated
+#define TRUE_PEAK_TAPS      12            // per phase of the 4x true peak interpolator
+#define METER_FLOOR_DB      -60.0f        // left end of the level meter bars
+#define REPLAY_BLOCK        512           // frames per callback() in --replay
+#define REPLAY_RUNS         5             // timed passes per replay case, the best one counts
+#define REPLAY_TOLERANCE    1e-3f         // max band error, relative to the case's largest band
+#define REPLAY_PERF_SLACK   15.0f         // median % slower than the baseline before a fail
+#define LIBRARY_PATH_MAX    512           // longest path kept in the library index
+#define LIBRARY_SETTLE_MS   500           // quiet time after file events before rewriting the index
+#define LIBRARY_ROWS        18            // tracks visible in the library browser
+#define SOAK_HIST_STEPS     8             // timing histogram bins per octave
+#define SOAK_HIST_BINS      (2 + 21 * SOAK_HIST_STEPS) // 1 us .. 2 s
+#define SOAK_TRACK_SECONDS  4.0           // --soak loads the next track this often
+#define SOAK_ACTION_SECONDS 0.5           // ... and seeks / switches mode / changes volume
+#define SOAK_SAMPLE_SECONDS 30.0          // ... and records RSS, fds and percentiles
+
 /**************************************************
  * @COLOR PALETTE
  **************************************************/
@@ -55,6 +126,21 @@ typedef enum
   NUM_MODES = 5
 } VisualizationMode;
 
+typedef enum
+{
+  ENGINE_FFT,       // full N-point FFT per block (+ optional decimated bass FFT)
+  ENGINE_RESONATOR, // one complex resonator per band, updated every sample
+  NUM_ENGINES = 2
+} AnalysisEngine;
+
+typedef enum
+{
+  PCM_F32LE,
+  PCM_S16LE,
+  PCM_S24LE,
+  PCM_S32LE
+} PcmFormat;
+
 typedef struct
 {
   char  title[128];
@@ -63,6 +149,41 @@ typedef struct
   float duration; // returns in seconds
 } MusicMetadata;
 
+/* Level meters, see @LOUDNESS METERING; -INFINITY until there is signal */
+typedef struct
+{
+  float momentary;     // LUFS, 400 ms
+  float short_term;    // LUFS, 3 s
+  float integrated;    // LUFS, gated, since the stream started
+  float rms;           // dBFS, 400 ms, louder channel
+  float true_peak;     // dBTP, 400 ms
+  float true_peak_max; // dBTP since the stream started
+} LoudnessReading;
+
+/* One published analysis result, produced by callback() and consumed by the render loop */
+typedef struct
+{
+  float    bands[BANDS_MAX]; // peak amp() per log-spaced band
+  size_t   band_count;
+  float    peak; // max over bands, used for normalization
+  uint64_t seq;  // 1-based publish counter
+  float    onset;      // spectral flux of this hop
+  uint32_t beat_count; // beats detected so far, a change means a new beat
+  float    beat_strength;
+  float    bpm;      // 0 until a tempo has been established
+  double   position; // stream seconds at the end of the analyzed block
+  double   time;     // now_seconds() at publish time
+  LoudnessReading loudness;
+} AnalysisFrame;
+
+/* Single 2:1 polyphase FIR stage, even/odd taps kept as separate sub-filters */
+typedef struct
+{
+  float  hist[2][DECIM_PHASE_TAPS * 2]; // mirrored ring per phase for contiguous dot products
+  size_t pos;
+  int    phase;
+} DecimStage;
+
 /********************************************************
  * $GLOBAL VARIABLES DECLARATION
  ********************************************************/
@@ -72,17 +193,53 @@ float             global_frames[4800] = {0};
 size_t            global_frames_count = 0;
 float             in[N];
 float complex     out[N];
-float             max_amp;
+float             low_in[N]; // decimated mono history for the bass FFT
+float complex     low_out[N];
+_Atomic unsigned  analysis_sample_rate = 44100;
+_Atomic int       requested_decimation = 1; // 1 (off), 2, 4 or 8
+_Atomic int       requested_engine     = ENGINE_FFT;
+bool              bench_mode           = false;
+_Atomic int       quality_level        = 0;    // index into qualityLevels, set by the governor
+_Atomic float     analysis_load        = 0.0f; // callback() time / block duration
+_Atomic unsigned  analysis_epoch       = 0; // bumping it makes callback() start from scratch
+_Atomic unsigned  analysis_stream      = 0; // ... and this one also resets the loudness meter
+bool              drawDecorations      = true;
+bool              drawSmoothing        = true;
+bool              idleRendering        = true; // see @IDLE-AWARE RENDERING
+int               avOffsetMs           = 0;    // manual part of @LATENCY COMPENSATION
+int               devicePeriods        = LATENCY_PERIODS; // --device-periods
+bool              startupStats         = false; // --startup-stats, see @STARTUP
+_Atomic bool      first_audio_seen     = false; // a non-silent block has reached callback()
+double            first_audio_time     = 0.0;   // now_seconds() of that block
+const char*       shmName              = NULL; // --shm, see raven_shm.h
+const char*       pcmPath              = NULL; // --pcm, "-" for stdin
+unsigned          pcmRate              = 44100;
+unsigned          pcmChannels          = 2;
+PcmFormat         pcmFormat            = PCM_F32LE;
+const char*       replayDir            = NULL; // --replay, see @REPLAY
+bool              replayRecord         = false; // --record: goldens and baseline
+bool              replayBaseline       = false; // --record=baseline: the baseline only
+float             replayPerfSlack      = REPLAY_PERF_SLACK; // < 0: --perf-slack=off
+const char*       libraryRoot          = NULL; // --library, "" for ~/Music, see @MUSIC LIBRARY
+double            soakMinutes          = 0.0;  // --soak, see @SOAK TEST
+const char*       soakReportPath       = "soak-report.txt";
 char              selected_song[512];
 VisualizationMode currentMode = STANDARD;
 const char* helpCommands[]    = {"f            - Play a media file (GTK file dialog will open)\n",
                                  "<Space>      - Pause music\n",
                                  "m            - Toggle mute\n",
                                  "<UP-ARROW>   - Increase volume by 10%\n",
-                                 "<DOWN-ARROW> - Decrease volume by 10%\n\n",
+                                 "<DOWN-ARROW> - Decrease volume by 10%\n",
+                                 "<LEFT/RIGHT> - Seek 5 s back / forward\n",
+                                 "<TAB>        - Browse and search the music library\n\n",
                                  "----------------- VISUAL MODES ---------------------\n\n",
                                  "v            - Cycle through visual modes (forward)\n",
                                  "b            - Cycle through visual modes (backward)\n",
+                                 "e            - Switch analysis engine (FFT/resonators)\n",
+                                 "d            - Cycle bass decimation (off/2x/4x/8x)\n",
+                                 "g            - Toggle the adaptive quality governor\n",
+                                 "[ / ]        - Show the spectrum 5 ms earlier / later\n",
+                                 "l            - Toggle the loudness / level meters\n",
                                  "? - Display the list of available commands"};
 
 /*************************************************************
@@ -183,472 +340,5452 @@ float amp(float complex z)
   return a;
 }
 
+double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 void SwitchVisualizationModeForward() { currentMode = (currentMode + 1) % NUM_MODES; }
 
-void SwitchVisualizationModeBackward() { currentMode = (currentMode - 1) % NUM_MODES; }
+void SwitchVisualizationModeBackward() { currentMode = (currentMode + NUM_MODES - 1) % NUM_MODES; }
 
-void callback(void* bufferData, unsigned int frames)
+/*************************************************************
+ *
+ * @BAND LAYOUT
+ *
+ * The visuals work on log-spaced bands [f, f * BAND_STEP)
+ * starting at BAND_FREQ_MIN, the same stepping that used to
+ * only be counted in main(). Every band knows which spectrum
+ * (full rate or decimated) and which bin range it reads, so
+ * the per-callback band pass is a handful of max() calls.
+ *
+ ************************************************************/
+
+typedef struct
 {
+  size_t count;
+  size_t fft_size; // n <= N, the newest n samples are transformed
+  float  scale;    // N / n, keeps band values independent of fft_size
+  size_t lo_bin[BANDS_MAX]; // first bin (inclusive)
+  size_t hi_bin[BANDS_MAX]; // last bin (exclusive)
+  bool   from_low[BANDS_MAX];
+} BandLayout;
 
-  float(*fs)[2] = bufferData;
+size_t CountBands(float step)
+{
+  size_t m = 0;
+  for (float f = BAND_FREQ_MIN; f < N && m < BANDS_MAX; f *= step)
+  {
+    m++;
+  }
+  return m;
+}
 
-  for (size_t i = 0; i < frames; i++)
+static void BandBins(float lo_hz, float hi_hz, float rate, size_t n, size_t* lo, size_t* hi)
+{
+  float  bin_hz = rate / n;
+  size_t a      = (size_t)ceilf(lo_hz / bin_hz);
+  size_t b      = (size_t)ceilf(hi_hz / bin_hz);
+  if (b <= a)
   {
-    memmove(in, in + 1, (N - 1) * sizeof(in[0]));
-    in[N - 1] = (fs[i][0] + fs[i][1]) / 2;
+    // Band narrower than a bin: fall back to the nearest bin to its center
+    a = (size_t)(0.5f * (lo_hz + hi_hz) / bin_hz + 0.5f);
+    b = a + 1;
   }
+  if (b > n / 2)
+    b = n / 2;
+  if (a >= b)
+    a = b - 1;
+  *lo = a;
+  *hi = b;
+}
 
-  fft(in, 1, out, N);
+void BuildBandLayout(BandLayout* layout, float rate, int decimation, float step, size_t n)
+{
+  float crossover = 0.0f;
+  if (decimation > 1)
+  {
+    crossover = 0.4f * rate / decimation; // stay inside the decimation filter's passband
+    if (crossover > DECIM_CROSSOVER_HZ)
+      crossover = DECIM_CROSSOVER_HZ;
+  }
 
-  max_amp = 0.0f;
-  for (size_t i = 0; i < frames; i++)
+  layout->count    = CountBands(step);
+  layout->fft_size = n;
+  layout->scale    = (float)N / n;
+  float f          = BAND_FREQ_MIN;
+  for (size_t k = 0; k < layout->count; k++, f *= step)
   {
-    float a = amp(out[i]);
-    if (max_amp < a)
-      max_amp = a;
+    float hi            = f * step;
+    layout->from_low[k] = hi <= crossover;
+    if (layout->from_low[k])
+      BandBins(f, hi, rate / decimation, n, &layout->lo_bin[k], &layout->hi_bin[k]);
+    else
+      BandBins(f, hi, rate, n, &layout->lo_bin[k], &layout->hi_bin[k]);
   }
 }
 
-int is_song_file(const char* filename)
+void ComputeBands(const BandLayout* layout, const float complex* full, const float complex* low,
+                  AnalysisFrame* frame)
 {
-  const char* extensions[] = {".mp3", ".wav", ".flac", ".aac", ".ogg", NULL};
-  for (int i = 0; extensions[i] != NULL; i++)
+  frame->band_count = layout->count;
+  frame->peak       = 0.0f;
+  for (size_t k = 0; k < layout->count; k++)
   {
-    if (strstr(filename, extensions[i]) != NULL)
+    const float complex* spectrum = layout->from_low[k] ? low : full;
+    float                a        = 0.0f;
+    for (size_t i = layout->lo_bin[k]; i < layout->hi_bin[k]; i++)
     {
-      return 1; // It is a song file
+      float v = amp(spectrum[i]);
+      if (a < v)
+        a = v;
     }
+    a *= layout->scale;
+    frame->bands[k] = a;
+    if (frame->peak < a)
+      frame->peak = a;
   }
-  return 0; // Not a song file
 }
 
-// Function to draw a cool rectangle (reused from earlier)
-void DrawCoolRectangle(float x, float y, float width, float height, Color color)
+/*************************************************************
+ *
+ * @POLYPHASE DECIMATION
+ *
+ * Bass resolution of an FFT is rate / N. Instead of raising
+ * N for the whole spectrum, the mono signal is low-passed and
+ * decimated by 2 up to three times (2x, 4x, 8x) and a second
+ * N-point FFT runs on that slower stream, giving D times finer
+ * bins for the low bands only.
+ *
+ * $POLYPHASE
+ *
+ * A 2:1 decimator only needs every other output of its FIR,
+ * so the taps are split into even and odd sub-filters that
+ * each run at the output rate:
+ *
+ *   y[m] = sum h[2k] x[2m - 2k] + sum h[2k + 1] x[2m - 2k - 1]
+ *
+ * That is DECIM_TAPS / 2 MACs per input sample per stage, and
+ * since every stage halves the rate the whole 8x chain costs
+ * less than two stages at full rate.
+ *
+ * $ALIGNMENT
+ *
+ * D times finer bins take a D times longer window: the
+ * decimated FFT covers the newest n * D input samples, so its
+ * bands describe the audio (D - 1) * n / 2 samples before the
+ * full-rate bands do (0.65 s at 8x, n = N, 44.1 kHz). Instead
+ * of mixing two moments in one frame, DecimAlign() holds the
+ * full-rate bands back by that many hops and stamps the frame
+ * with the older position, so @LATENCY COMPENSATION and the
+ * beat tracker see when the whole frame was actually heard.
+ * The visuals lag by the same amount while decimation is on;
+ * that is the price of the resolution.
+ *
+ ************************************************************/
+
+float      decim_taps[2][DECIM_PHASE_TAPS]; // [phase][k], reversed for the dot product
+DecimStage decim_stages[DECIM_STAGES_MAX];
+
+void InitDecimationFilter(void)
 {
-  DrawRectangle(x, y, width, height, color);                        // Use passed color
-  DrawRectangleLines(x, y, width, height, ColorAlpha(color, 0.3f)); // Gruvbox foreground
-  DrawCircle(x + width / 2, y, width / 4, ColorAlpha(color, 0.2f)); // Aqua as an accent
+  /* Blackman windowed-sinc low-pass with its cutoff at the output Nyquist (0.25 of the input
+   * rate). The passband is only relied on up to DECIM_CROSSOVER_HZ, far below the transition */
+  float h[DECIM_TAPS];
+  float sum = 0.0f;
+  for (int i = 0; i < DECIM_TAPS; i++)
+  {
+    float x = i - (DECIM_TAPS - 1) / 2.0f;
+    float s = x == 0.0f ? 0.5f : sinf(pi * 0.5f * x) / (pi * x);
+    float w = 0.42f - 0.5f * cosf(2 * pi * i / (DECIM_TAPS - 1)) +
+              0.08f * cosf(4 * pi * i / (DECIM_TAPS - 1));
+    h[i] = s * w;
+    sum += h[i];
+  }
+  for (int i = 0; i < DECIM_TAPS; i++)
+  {
+    // Phase p holds h[2k + p], reversed so the last entry meets the newest sample
+    decim_taps[i % 2][DECIM_PHASE_TAPS - 1 - i / 2] = h[i] / sum; // unity DC gain
+  }
 }
 
-// Function to check if the mouse is hovering over a rectangle (used for the info button)
-bool IsMouseOverRectangle(Rectangle rect)
+void ResetDecimation(void)
 {
-  Vector2 mouse = GetMousePosition();
-  return CheckCollisionPointRec(mouse, rect);
+  memset(decim_stages, 0, sizeof(decim_stages));
+  memset(low_in, 0, sizeof(low_in));
 }
 
-// Function to open a GTK file dialog and update the selected_song path
-void OpenFileDialog()
+/* Feeds one sample into a stage; returns true and writes *y when an output sample is due */
+static bool DecimStagePush(DecimStage* st, float x, float* y)
 {
-  GtkWidget*           dialog;
-  GtkFileChooser*      chooser;
-  GtkFileChooserAction action = GTK_FILE_CHOOSER_ACTION_OPEN;
+  /* The second sample of each pair is the newest (x[2m]) and meets the even taps,
+   * the first one (x[2m - 1]) meets the odd taps */
+  int    p  = st->phase;
+  size_t at = st->pos;
+  st->hist[p][at]                    = x;
+  st->hist[p][at + DECIM_PHASE_TAPS] = x;
+  st->phase ^= 1;
+  if (st->phase)
+    return false;
 
-  // Initialize GTK only once, before the dialog
-  if (!gtk_init_check(0, NULL))
+  st->pos = (st->pos + 1) % DECIM_PHASE_TAPS;
+
+  const float* even = &st->hist[1][st->pos]; // x[2m - 2k]
+  const float* odd  = &st->hist[0][st->pos]; // x[2m - 2k - 1]
+  float        acc  = 0.0f;
+  for (int k = 0; k < DECIM_PHASE_TAPS; k++)
   {
-    printf("Failed to initialize GTK!\n");
-    return;
+    acc += decim_taps[0][k] * even[k] + decim_taps[1][k] * odd[k];
   }
+  *y = acc;
+  return true;
+}
 
-  dialog = gtk_file_chooser_dialog_new("Open File", NULL, action, "_Cancel", GTK_RESPONSE_CANCEL,
-                                       "_Open", GTK_RESPONSE_ACCEPT, NULL);
-
-  chooser = GTK_FILE_CHOOSER(dialog);
-
-  // Process the dialog event in a non-blocking way
-  if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+/* Runs the 2:1 cascade for one full-rate sample; returns true when a decimated sample is out */
+bool DecimatePush(float x, int stages, float* y)
+{
+  for (int s = 0; s < stages; s++)
   {
-    char* file_name = gtk_file_chooser_get_filename(chooser);
-    strncpy(selected_song, file_name, sizeof(selected_song) - 1);
-    selected_song[sizeof(selected_song) - 1] = '\0'; // Null-terminate string
-    g_free(file_name);
+    if (!DecimStagePush(&decim_stages[s], x, &x))
+      return false;
   }
+  *y = x;
+  return true;
+}
 
-  // Destroy the dialog widget after the response
-  gtk_widget_destroy(dialog);
+typedef struct
+{
+  AnalysisFrame frames[DECIM_ALIGN_HOPS]; // recent frames, full-rate bands still undelayed
+  size_t        count;
+} DecimAligner;
 
-  // Ensure any pending GTK events are processed
-  while (gtk_events_pending())
-  {
-    gtk_main_iteration();
-  }
-}
-
-void handleVisualization(float cell_width, const int screenHeight, const int screenWidth, size_t m)
-{
-  Vector2 center = {screenWidth / 2, screenHeight / 2}; // Calculate the center point for drawing
-  float   step   = 0.4f;                                // [0.01 - 0.06 looks good ig]
-  float   maxAmplitude = max_amp > 0 ? max_amp : 1;
-
-  // Calculate amplitude for all points once
-  float amplitudes[N];
-  for (size_t i = 0; i < N; i++)
-  {
-    amplitudes[i] = amp(out[i]) / maxAmplitude; // Normalize amplitude
-  }
-
-  // Store previous amplitudes for smoothing
-  static float previousAmplitudes[N] = {0};
-
-  for (size_t i = 0; i < N - 1; i++)
-  {
-    if (amplitudes[i] > 0.01f)
-    {
-      switch (currentMode)
-      {
-        /*******************************************************
-         *
-         * @STANDARD MODE
-         *
-         * Draws rectangles representing amplitudes as bars.
-         * The height of each rectangle corresponds to the amplitude.
-         *
-         *******************************************************/
-        case STANDARD:
-        {
-          DrawCoolRectangle(i * cell_width, screenHeight - screenHeight * amplitudes[i],
-                            cell_width * step, screenHeight * amplitudes[i], GRUVBOX_RED);
-          break;
-        }
-
-        /*******************************************************
-         *
-         * @PIXEL MODE
-         *
-         * Similar to STANDARD, but with a larger step to create
-         * a pixelated effect. This enhances the blocky appearance.
-         *
-         *******************************************************/
-        case PIXEL:
-        {
-          step = 1.06f; // Adjust step for pixelated effect
-          DrawCoolRectangle(i * cell_width, screenHeight - screenHeight * amplitudes[i],
-                            cell_width * step, screenHeight * amplitudes[i], GRUVBOX_PURPLE);
-          break;
-        }
-
-        /*******************************************************
-         *
-         * @WAVEFORM MODE
-         *
-         * Visualizes the amplitudes as a line waveform.
-         * Connects the amplitude points with lines for smooth transitions.
-         *
-         *******************************************************/
-        case WAVEFORM:
-        {
-          Vector2 start = {i * cell_width, center.y + (screenHeight / 2) * amplitudes[i]};
-          Vector2 end   = {(i + 1) * cell_width, center.y + (screenHeight / 2) * amplitudes[i + 1]};
-          DrawLineEx(start, end, 2.0f, GRUVBOX_BLUE);
-          break;
-        }
-
-        /*******************************************************
-         *
-         * @STARBURST MODE
-         *
-         * Draws radial lines (rays) emanating from the center.
-         * Each ray's length is determined by the amplitude, and
-         * color varies based on the index.
-         *
-         *******************************************************/
-        case STARBURST:
-        {
-          float   angle = i * 360.0f / m; // Calculate angle for each ray WRT freq range
-          Vector2 end   = {center.x + cos(angle * DEG2RAD) * amplitudes[i] * (screenHeight / 2),
-                           center.y + sin(angle * DEG2RAD) * amplitudes[i] * (screenHeight / 2)};
-
-          // Select a color based on the index
-          Color rayColor;
-          switch (i % 6)
-          {
-            case 0:
-              rayColor = GRUVBOX_YELLOW;
-              break;
-            case 1:
-              rayColor = GRUVBOX_BLUE;
-              break;
-            case 2:
-              rayColor = GRUVBOX_GREEN;
-              break;
-            case 3:
-              rayColor = GRUVBOX_RED;
-              break;
-            case 4:
-              rayColor = GRUVBOX_ORANGE;
-              break;
-            case 5:
-              rayColor = GRUVBOX_PURPLE;
-              break;
-          }
-
-          DrawLineEx(center, end, 2.0f, rayColor); // Draw the ray
-          break;
-        }
-
-        /*******************************************************
-         *
-         * @RADIAL BARS MODE
-         *
-         * Draws bars radiating from the center, similar to STARBURST,
-         * but using circular sections. The length of each bar is
-         * based on the amplitude, and bars have a color scheme.
-         *
-         *******************************************************/
-        case RADIAL_BARS:
-        {
-          float angle       = i * 360.0f / m;   // Calculate angle for each bar WRT audio freq range
-          float innerRadius = screenHeight / 8; // Radius for inner circle
-          float outerRadius = screenHeight / 4; // Base radius for bars
-          float amplitudeScale = screenHeight / 4; // Scaling factor for amplitude
-
-          // Draw the inner circle
-          DrawCircle(center.x, center.y, innerRadius, GRUVBOX_FG);
-          DrawCircleLines(center.x, center.y, innerRadius, GRUVBOX_FG);
-
-          Vector2 start = {center.x + cos(angle * DEG2RAD) * outerRadius,
-                           center.y + sin(angle * DEG2RAD) * outerRadius};
-
-          // Use a smoothed amplitude value [by taking average of prev and current amps]
-          float smoothedAmplitude =
-            (previousAmplitudes[i] + amplitudes[i]) * 0.5; // Simple averaging
-          previousAmplitudes[i] = smoothedAmplitude;       // Store for next frame
-
-          Vector2 end = {
-            center.x + cos(angle * DEG2RAD) * (outerRadius + smoothedAmplitude * amplitudeScale),
-            center.y + sin(angle * DEG2RAD) * (outerRadius + smoothedAmplitude * amplitudeScale)};
-
-          // Color selection
-          Color barColor;
-          switch (i % 6)
-          {
-            case 0:
-              barColor = GRUVBOX_YELLOW;
-              break;
-            case 1:
-              barColor = GRUVBOX_BLUE;
-              break;
-            case 2:
-              barColor = GRUVBOX_GREEN;
-              break;
-            case 3:
-              barColor = GRUVBOX_ORANGE;
-              break;
-            case 4:
-              barColor = GRUVBOX_AQUA;
-              break;
-            case 5:
-              barColor = GRUVBOX_PURPLE;
-              break;
-          }
-
-          DrawLineEx(start, end, cell_width * step, barColor); // Draw the radial bar
-          break;
-        }
-      }
-    }
-  }
+/* Hops the full-rate bands are held back for the decimated ones at the same fft_size n */
+size_t DecimAlignHops(int decimation, size_t n)
+{
+  return decimation > 1 ? ((decimation - 1) * n / 2 + ANALYSIS_HOP / 2) / ANALYSIS_HOP : 0;
 }
 
-void DrawHelpBox(bool showHelp, Font font, const int screenHeight, const int screenWidth)
+/* Pairs this hop's decimated bands with the full-rate bands from delay hops ago, in place;
+ * false while there is not enough history yet */
+bool DecimAlign(DecimAligner* al, const BandLayout* layout, size_t delay, AnalysisFrame* frame)
 {
-  if (showHelp)
+  assert(delay < DECIM_ALIGN_HOPS);
+  al->frames[al->count % DECIM_ALIGN_HOPS] = *frame;
+  al->count++;
+  if (al->count <= delay)
+    return false;
+
+  AnalysisFrame aligned = al->frames[(al->count - 1 - delay) % DECIM_ALIGN_HOPS];
+  aligned.peak          = 0.0f;
+  for (size_t k = 0; k < layout->count; k++)
   {
-    int boxWidth  = screenWidth / 2;
-    int boxHeight = screenHeight / 2 + 7; // some padding
-    int boxX      = (GetScreenWidth() - boxWidth) / 2;
-    int boxY      = (GetScreenHeight() - boxHeight) / 2;
+    if (layout->from_low[k])
+      aligned.bands[k] = frame->bands[k];
+    if (aligned.peak < aligned.bands[k])
+      aligned.peak = aligned.bands[k];
+  }
+  *frame = aligned;
+  return true;
+}
 
-    // Draw the outer glowing rectangle using Gruvbox red for the border
-    DrawRectangle(boxX - 10, boxY - 10, boxWidth + 20, boxHeight + 20, GRUVBOX_RED);
-    DrawRectangle(boxX, boxY, boxWidth, boxHeight,
-                  ColorAlpha(GRUVBOX_BG, 0.95f)); // Gruvbox background
+/*************************************************************
+ *
+ * @RESONATOR BANK
+ *
+ * The visuals only look at ~100 bands, so instead of a full
+ * FFT per block this engine keeps one complex one-pole
+ * resonator (a leaky sliding DFT bin) per band center:
+ *
+ *   y[n] = x[n] + r * e^(i*w) * y[n - 1]
+ *
+ * w is the band's geometric center and r = e^(-pi * B / rate)
+ * sets a -3 dB bandwidth B equal to the band width, so every
+ * band is exactly as wide as the layout says. The update is
+ * O(bands) per sample with no window, i.e. no block latency.
+ *
+ * State is kept as separate re/im arrays so the per-sample
+ * loop over bands is a plain multiply-add the compiler can
+ * vectorize.
+ *
+ * $SCALE
+ *
+ * A cosine of amplitude A settles at |y| = (A / 2) / (1 - r),
+ * while an N-point FFT bin reads A * N / 2. Scaling by
+ * N * (1 - r) keeps both engines on the same amplitude scale.
+ *
+ ************************************************************/
 
-    // Title with Gruvbox yellow
-    DrawTextEx(font, "Help for rAVen:", (Vector2){boxX + 20, boxY + 20}, 30, 2, GRUVBOX_YELLOW);
+typedef struct
+{
+  size_t count;
+  float  re[BANDS_MAX];
+  float  im[BANDS_MAX];
+  float  cr[BANDS_MAX]; // r * cos(w)
+  float  ci[BANDS_MAX]; // r * sin(w)
+  float  gain[BANDS_MAX];
+} ResonatorBank;
 
-    // Display help commands in Gruvbox foreground
-    char helpText[1024];
-    snprintf(helpText, sizeof(helpText), "Commands:\n");
-    for (int i = 0; i < ARRAY_LEN(helpCommands); i++)
-    {
-      snprintf(helpText + strlen(helpText), sizeof(helpText) - strlen(helpText), "%s\n",
-               helpCommands[i]);
-    }
-    DrawTextEx(font, helpText, (Vector2){boxX + 20, boxY + 60}, 20, 1, GRUVBOX_FG);
+void InitResonatorBank(ResonatorBank* bank, float rate, float step)
+{
+  memset(bank, 0, sizeof(*bank));
+  bank->count = CountBands(step);
+  float f     = BAND_FREQ_MIN;
+  for (size_t k = 0; k < bank->count; k++, f *= step)
+  {
+    float center = f * sqrtf(step);
+    float width  = f * (step - 1.0f);
+    float r      = expf(-pi * width / rate);
+    float w      = 2 * pi * center / rate;
+    bank->cr[k]   = r * cosf(w);
+    bank->ci[k]   = r * sinf(w);
+    bank->gain[k] = N * (1.0f - r);
   }
 }
 
-void LimitText(char* dest, const char* src, int maxLength)
+void ResonatorBankProcess(ResonatorBank* bank, const float* xs, size_t count)
 {
-  if (strlen(src) > maxLength)
+  size_t m = bank->count;
+  for (size_t i = 0; i < count; i++)
   {
-    strncpy(dest, src, maxLength - 3); // Copy up to maxLength - 3 characters
-    dest[maxLength - 3] = '\0';        // Ensure null termination
-    strcat(dest, "...");               // Append "..." to indicate truncation
+    float x = xs[i];
+    for (size_t k = 0; k < m; k++)
+    {
+      float re    = bank->re[k];
+      float im    = bank->im[k];
+      bank->re[k] = x + bank->cr[k] * re - bank->ci[k] * im;
+      bank->im[k] = bank->cr[k] * im + bank->ci[k] * re;
+    }
   }
-  else
+
+  // Flush decayed state before it turns denormal during silence
+  for (size_t k = 0; k < m; k++)
   {
-    strcpy(dest, src); // Copy the full string if it fits within the limit
+    if (fabsf(bank->re[k]) < 1e-15f && fabsf(bank->im[k]) < 1e-15f)
+    {
+      bank->re[k] = 0.0f;
+      bank->im[k] = 0.0f;
+    }
   }
 }
 
-void DrawSpaceTheme(Font font, Music music, MusicMetadata* metadata)
+void ResonatorBankBands(const ResonatorBank* bank, AnalysisFrame* frame)
 {
-  // Constants
-  int boxWidth  = 400; // Width of the text box
-  int padding   = 40;  // Padding for the text inside the box
-  int charLimit = 30;  // Maximum character limit for each line (adjust as needed)
-
-  // Draw the outer glowing rectangle for space-themed effect
-  DrawRectangle(15, 95, 410, 210, GRUVBOX_BLUE); // Outer glow effect
-  DrawRectangle(20, 100, boxWidth, 200,
-                ColorAlpha(GRUVBOX_BG, 0.85f)); // Main box with Gruvbox background
-
-  // Draw the title with a Gruvbox-style glowing effect
-  DrawTextEx(font, "Track Info", (Vector2){padding, 110}, 24, 2,
-             GRUVBOX_YELLOW); // Gruvbox yellow for title
-
-  // Create and display the text with metadata
-  char title[128], artist[128], album[128];
-  LimitText(title, metadata->title[0] ? metadata->title : "Unknown", charLimit);
-  LimitText(artist, metadata->artist[0] ? metadata->artist : "Unknown", charLimit);
-  LimitText(album, metadata->album[0] ? metadata->album : "Unknown", charLimit);
-
-  char infoText[512];
-  snprintf(infoText, sizeof(infoText),
-           "Title: %s\nArtist: %s\nAlbum: %s\nSample Rate: %d Hz\nChannels: %d\nSample Size: "
-           "%d-bit\nDuration: %.2f sec",
-           title, artist, album, music.stream.sampleRate, music.stream.channels,
-           music.stream.sampleSize, metadata->duration);
-
-  // Display the metadata text with Gruvbox foreground color
-  DrawTextEx(font, infoText, (Vector2){padding, 150}, 20, 1, GRUVBOX_FG);
-
-  // Add additional space elements (stars, nebula effect, etc.)
-  for (int i = 0; i < 50; i++)
+  frame->band_count = bank->count;
+  frame->peak       = 0.0f;
+  for (size_t k = 0; k < bank->count; k++)
   {
-    DrawCircle(rand() % 450 + 20, rand() % 220 + 100, 1,
-               ColorAlpha(GRUVBOX_FG, 0.5f)); // Stars using Gruvbox foreground color
+    float a = bank->gain[k] * sqrtf(bank->re[k] * bank->re[k] + bank->im[k] * bank->im[k]);
+    frame->bands[k] = a;
+    if (frame->peak < a)
+      frame->peak = a;
   }
-
-  // Add a glowing nebula at the bottom-right corner using Gruvbox colors
-  DrawCircleGradient(380, 280, 50, ColorAlpha(GRUVBOX_AQUA, 0.2f),
-                     ColorAlpha(GRUVBOX_PURPLE, 0.0f)); // Nebula glow using Gruvbox aqua and purple
 }
 
-void extract_metadata(const char* filename, MusicMetadata* metadata)
+/*************************************************************
+ *
+ * @BEAT TRACKING
+ *
+ * Runs on the band magnitudes after every hop (one callback
+ * block), whichever engine produced them, so it costs no
+ * extra FFT:
+ *
+ * $SPECTRAL FLUX
+ *
+ * Bands are log-compressed and only rises are summed, so a
+ * kick that lifts many bands at once stands out while steady
+ * tones contribute nothing.
+ *
+ * $ADAPTIVE THRESHOLD
+ *
+ * A hop is an onset if its flux exceeds mean + 1.5 * stddev of
+ * the last FLUX_HISTORY hops (kept as running sums, O(1)) and
+ * is a local maximum. Checking "local maximum" needs the next
+ * hop, which is the only latency added: exactly one hop.
+ *
+ * $TEMPO
+ *
+ * Each beat votes for the intervals to the previous
+ * BEAT_TIMES beats, folded into [TEMPO_MIN_BPM, TEMPO_MAX_BPM),
+ * in a decaying histogram; its maximum is the BPM.
+ *
+ ************************************************************/
+
+#define TEMPO_BINS (TEMPO_MAX_BPM - TEMPO_MIN_BPM)
+
+typedef struct
 {
-  AVFormatContext* fmt_ctx = NULL;
+  float    prev[BANDS_MAX]; // log-compressed bands of the previous hop
+  size_t   prev_count;
+  float    flux_hist[FLUX_HISTORY];
+  size_t   flux_pos;
+  size_t   flux_fill;
+  double   flux_sum;
+  double   flux_sumsq;
+  float    flux_prev;   // flux of the candidate hop (n - 1)
+  float    flux_prev2;  // flux of hop n - 2
+  float    thresh_prev; // threshold that applied to the candidate hop
+  double   time;        // seconds of audio analyzed so far
+  double   prev_time;   // time at the end of the candidate hop
+  double   beat_times[BEAT_TIMES];
+  size_t   beat_pos;
+  float    tempo_hist[TEMPO_BINS];
+  uint32_t beat_count;
+  float    beat_strength;
+  float    bpm;
+} BeatTracker;
 
-  // Open the audio file and read its header
-  if (avformat_open_input(&fmt_ctx, filename, NULL, NULL) < 0)
+static void BeatTrackerVoteTempo(BeatTracker* bt, double t)
+{
+  for (size_t b = 0; b < TEMPO_BINS; b++)
   {
-    printf("Could not open file: %s\n", filename);
-    return;
+    bt->tempo_hist[b] *= 0.9f;
   }
 
-  // Retrieve stream information
-  if (avformat_find_stream_info(fmt_ctx, NULL) < 0)
+  for (size_t j = 0; j < BEAT_TIMES; j++)
   {
-    printf("Could not find stream information\n");
-    avformat_close_input(&fmt_ctx);
-    return;
+    double ioi = t - bt->beat_times[(bt->beat_pos + BEAT_TIMES - 1 - j) % BEAT_TIMES];
+    if (bt->beat_times[(bt->beat_pos + BEAT_TIMES - 1 - j) % BEAT_TIMES] <= 0.0 || ioi <= 0.0 ||
+        ioi > 4.0)
+      continue;
+
+    float bpm = 60.0f / ioi;
+    while (bpm < TEMPO_MIN_BPM)
+      bpm *= 2.0f;
+    while (bpm >= TEMPO_MAX_BPM)
+      bpm *= 0.5f;
+
+    // Spread the vote over the neighbouring bins, nearer beats weigh more
+    int   bin    = (int)(bpm - TEMPO_MIN_BPM);
+    float weight = 1.0f / (j + 1);
+    for (int d = -1; d <= 1; d++)
+    {
+      if (bin + d >= 0 && bin + d < TEMPO_BINS)
+        bt->tempo_hist[bin + d] += d == 0 ? weight : 0.5f * weight;
+    }
   }
 
-  AVDictionaryEntry* tag = NULL;
+  bt->beat_times[bt->beat_pos] = t;
+  bt->beat_pos                 = (bt->beat_pos + 1) % BEAT_TIMES;
 
-  // Extract metadata (title, artist, album)
-  if ((tag = av_dict_get(fmt_ctx->metadata, "title", NULL, 0)))
+  int best = 0;
+  for (int b = 1; b < TEMPO_BINS; b++)
   {
-    strncpy(metadata->title, tag->value, sizeof(metadata->title) - 1);
-    metadata->title[sizeof(metadata->title) - 1] = '\0';
+    if (bt->tempo_hist[b] > bt->tempo_hist[best])
+      best = b;
   }
-  else
+  if (bt->tempo_hist[best] < 1.0f)
+    return; // not enough agreement yet
+
+  // Parabolic interpolation around the winning bin
+  float offset = 0.0f;
+  if (best > 0 && best + 1 < TEMPO_BINS)
   {
-    strncpy(metadata->title, "Unknown Title", sizeof(metadata->title) - 1);
-    metadata->title[sizeof(metadata->title) - 1] = '\0';
+    float l = bt->tempo_hist[best - 1], c = bt->tempo_hist[best], r = bt->tempo_hist[best + 1];
+    float den = l - 2 * c + r;
+    if (den != 0.0f)
+      offset = 0.5f * (l - r) / den;
   }
+  bt->bpm = TEMPO_MIN_BPM + best + 0.5f + offset;
+}
 
-  if ((tag = av_dict_get(fmt_ctx->metadata, "artist", NULL, 0)))
+void BeatTrackerUpdate(BeatTracker* bt, AnalysisFrame* frame, double hop_seconds)
+{
+  // Spectral flux over log-compressed bands, normalized so it does not depend on N
+  float  flux = 0.0f;
+  size_t m    = frame->band_count;
+  for (size_t k = 0; k < m; k++)
   {
-    strncpy(metadata->artist, tag->value, sizeof(metadata->artist) - 1);
-    metadata->artist[sizeof(metadata->artist) - 1] = '\0';
+    float c = log1pf(100.0f * frame->bands[k] / N);
+    if (bt->prev_count == m && c > bt->prev[k])
+      flux += c - bt->prev[k];
+    bt->prev[k] = c;
   }
-  else
+  bt->prev_count = m;
+  flux           = m > 0 ? flux / m : 0.0f;
+
+  // Peak-pick the previous hop now that its successor is known
+  float  candidate = bt->flux_prev;
+  bool   is_peak   = candidate > bt->thresh_prev && candidate >= bt->flux_prev2 && candidate > flux;
+  double since     = bt->prev_time - bt->beat_times[(bt->beat_pos + BEAT_TIMES - 1) % BEAT_TIMES];
+  if (is_peak && since > 60.0 / TEMPO_MAX_BPM)
   {
-    strncpy(metadata->artist, "Unknown Artist", sizeof(metadata->artist) - 1);
-    metadata->artist[sizeof(metadata->artist) - 1] = '\0';
+    bt->beat_count++;
+    bt->beat_strength = candidate / (bt->thresh_prev > 0.0f ? bt->thresh_prev : 1.0f);
+    BeatTrackerVoteTempo(bt, bt->prev_time);
   }
 
-  if ((tag = av_dict_get(fmt_ctx->metadata, "album", NULL, 0)))
+  // Update the running threshold statistics with this hop
+  if (bt->flux_fill == FLUX_HISTORY)
   {
-    strncpy(metadata->album, tag->value, sizeof(metadata->album) - 1);
-    metadata->album[sizeof(metadata->album) - 1] = '\0';
+    float old = bt->flux_hist[bt->flux_pos];
+    bt->flux_sum -= old;
+    bt->flux_sumsq -= (double)old * old;
   }
   else
   {
-    strncpy(metadata->album, "Unknown Album", sizeof(metadata->album) - 1);
-    metadata->album[sizeof(metadata->album) - 1] = '\0';
+    bt->flux_fill++;
   }
+  bt->flux_hist[bt->flux_pos] = flux;
+  bt->flux_pos                = (bt->flux_pos + 1) % FLUX_HISTORY;
+  bt->flux_sum += flux;
+  bt->flux_sumsq += (double)flux * flux;
 
-  // Extract duration in seconds
-  metadata->duration = fmt_ctx->duration / (float)AV_TIME_BASE;
+  double mean = bt->flux_sum / bt->flux_fill;
+  double var  = bt->flux_sumsq / bt->flux_fill - mean * mean;
+  float  sd   = var > 0.0 ? (float)sqrt(var) : 0.0f;
 
-  // Close the input context
-  avformat_close_input(&fmt_ctx);
+  bt->flux_prev2  = bt->flux_prev;
+  bt->flux_prev   = flux;
+  bt->thresh_prev = (float)mean + 1.5f * sd + 0.002f; // floor keeps silence from triggering
+  bt->time += hop_seconds;
+  bt->prev_time = bt->time;
+
+  frame->onset         = flux;
+  frame->beat_count    = bt->beat_count;
+  frame->beat_strength = bt->beat_strength;
+  frame->bpm           = bt->bpm;
 }
 
-int main(int argc, char* argv[])
-{
-  /******************************
-   * @SIGNAL DECLS
-   ******************************/
+/*************************************************************
+ *
+ * @LOUDNESS METERING
+ *
+ * ITU-R BS.1770 / EBU R128 meters, fed with every stereo
+ * sample in callback() before the mono mixdown:
+ *
+ * $K-WEIGHTING
+ *
+ * Two biquads per channel (high shelf + RLB high-pass) with
+ * coefficients derived for the actual sample rate. Both
+ * channels run in lockstep as two lanes of one loop, which
+ * compilers turn into 2-wide SIMD. Squared outputs are summed
+ * into 100 ms sub-blocks.
+ *
+ * $WINDOWS (O(1) per sample)
+ *
+ * Momentary (400 ms) and short-term (3 s) loudness are
+ * running sums over the last 4 / 30 sub-blocks. Every 100 ms
+ * the momentary block goes into a histogram of 0.1 LU bins
+ * (count + energy per bin), from which integrated loudness is
+ * gated: absolute gate at -70 LUFS, relative gate 10 LU below
+ * the ungated mean. No allocation, no per-block storage.
+ *
+ * $TRUE PEAK
+ *
+ * 4x oversampling with a 48-tap polyphase windowed sinc (12
+ * taps per phase, as in BS.1770 Annex 2), the peak being the
+ * largest magnitude of the original and interpolated samples.
+ *
+ * RMS is unweighted, over the momentary window, in dBFS.
+ *
+ ************************************************************/
 
-  signal(SIGABRT, rAVen_sig_abrt);
+typedef struct
+{
+  double b0, b1, b2, a1, a2;
+} Biquad;
 
-  const int screenWidth  = 1280;
-  const int screenHeight = 720;
+typedef struct
+{
+  unsigned rate;
+  Biquad   shelf, highpass;
+  double   z[2][2][2]; // [stage][state][channel]
+
+  size_t sub_size; // samples per 100 ms sub-block
+  size_t sub_fill;
+  double sub_energy; // K-weighted, both channels
+  double sub_raw[2]; // unweighted, per channel
+  float  sub_peak;
+
+  double energy[LUFS_SHORT_SUBS]; // per completed sub-block
+  double raw[LUFS_SHORT_SUBS][2];
+  float  peak[LUFS_SHORT_SUBS];
+  size_t subs; // sub-blocks completed
+  double momentary_sum, short_sum;
+  double raw_sum[2];
+
+  uint32_t hist_count[LUFS_HIST_BINS];
+  double   hist_energy[LUFS_HIST_BINS];
+
+  float  tp_taps[4][TRUE_PEAK_TAPS];      // [phase][k], reversed for the dot product
+  float  tp_hist[TRUE_PEAK_TAPS * 2][2]; // mirrored ring, [sample][channel]
+  size_t tp_pos;
+
+  LoudnessReading reading;
+} LoudnessMeter;
+
+static double LoudnessLufs(double mean_square)
+{
+  return mean_square > 0.0 ? -0.691 + 10.0 * log10(mean_square) : -INFINITY;
+}
+
+static float LoudnessDb(double x) { return x > 0.0 ? 20.0 * log10(x) : -INFINITY; }
+
+void InitLoudnessMeter(LoudnessMeter* lm, unsigned rate)
+{
+  memset(lm, 0, sizeof(*lm));
+  lm->rate     = rate;
+  lm->sub_size = rate / 10 > 0 ? rate / 10 : 1;
+
+  // High shelf, +4 dB above ~1.7 kHz
+  double K  = tan(M_PI * 1681.974450955533 / rate);
+  double Vh = pow(10.0, 3.999843853973347 / 20.0);
+  double Vb = pow(Vh, 0.4996667741545416);
+  double Q  = 0.7071752369554196;
+  double a0 = 1.0 + K / Q + K * K;
+  lm->shelf = (Biquad){(Vh + Vb * K / Q + K * K) / a0, 2.0 * (K * K - Vh) / a0,
+                       (Vh - Vb * K / Q + K * K) / a0, 2.0 * (K * K - 1.0) / a0,
+                       (1.0 - K / Q + K * K) / a0};
+
+  // RLB high-pass at ~38 Hz
+  K            = tan(M_PI * 38.13547087602444 / rate);
+  Q            = 0.5003270373238773;
+  a0           = 1.0 + K / Q + K * K;
+  lm->highpass = (Biquad){1.0, -2.0, 1.0, 2.0 * (K * K - 1.0) / a0, (1.0 - K / Q + K * K) / a0};
+
+  // True peak interpolator: sinc at the original Nyquist, Blackman window
+  for (int i = 0; i < 4 * TRUE_PEAK_TAPS; i++)
+  {
+    float x = (i - (4 * TRUE_PEAK_TAPS - 1) / 2.0f) / 4.0f;
+    float s = sinf(pi * x) / (pi * x);
+    float w = 0.42f - 0.5f * cosf(2 * pi * i / (4 * TRUE_PEAK_TAPS - 1)) +
+              0.08f * cosf(4 * pi * i / (4 * TRUE_PEAK_TAPS - 1));
+    lm->tp_taps[i % 4][TRUE_PEAK_TAPS - 1 - i / 4] = s * w;
+  }
+  // Unity DC gain per phase, or every interpolated sample is off by that phase's tap sum
+  for (int p = 0; p < 4; p++)
+  {
+    float sum = 0.0f;
+    for (int k = 0; k < TRUE_PEAK_TAPS; k++)
+      sum += lm->tp_taps[p][k];
+    for (int k = 0; k < TRUE_PEAK_TAPS; k++)
+      lm->tp_taps[p][k] /= sum;
+  }
+
+  lm->reading = (LoudnessReading){-INFINITY, -INFINITY, -INFINITY, -INFINITY, -INFINITY, -INFINITY};
+}
+
+/* A seek within the same stream: the sliding windows start over, but integrated loudness
+ * and the maximum true peak keep covering everything played since the stream started */
+void LoudnessSeek(LoudnessMeter* lm)
+{
+  memset(lm->z, 0, sizeof(lm->z));
+  lm->sub_fill   = 0;
+  lm->sub_energy = 0.0;
+  lm->sub_peak   = 0.0f;
+  memset(lm->sub_raw, 0, sizeof(lm->sub_raw));
+  memset(lm->energy, 0, sizeof(lm->energy));
+  memset(lm->raw, 0, sizeof(lm->raw));
+  memset(lm->peak, 0, sizeof(lm->peak));
+  memset(lm->raw_sum, 0, sizeof(lm->raw_sum));
+  memset(lm->tp_hist, 0, sizeof(lm->tp_hist));
+  lm->subs          = 0;
+  lm->momentary_sum = 0.0;
+  lm->short_sum     = 0.0;
+  lm->tp_pos        = 0;
+
+  LoudnessReading kept = lm->reading;
+  lm->reading          = (LoudnessReading){-INFINITY, -INFINITY, kept.integrated,
+                                           -INFINITY, -INFINITY, kept.true_peak_max};
+}
+
+/* Integrated loudness from the gating histogram */
+static float LoudnessIntegrated(const LoudnessMeter* lm)
+{
+  double energy = 0.0;
+  size_t count  = 0;
+  for (size_t b = 0; b < LUFS_HIST_BINS; b++)
+  {
+    energy += lm->hist_energy[b];
+    count += lm->hist_count[b];
+  }
+  if (count == 0)
+    return -INFINITY;
+
+  double relative = LoudnessLufs(energy / count) - 10.0;
+  long   first    = lround((relative - LUFS_ABSOLUTE_GATE) / LUFS_HIST_STEP);
+  energy          = 0.0;
+  count           = 0;
+  for (size_t b = first > 0 ? (size_t)first : 0; b < LUFS_HIST_BINS; b++)
+  {
+    energy += lm->hist_energy[b];
+    count += lm->hist_count[b];
+  }
+  return count ? LoudnessLufs(energy / count) : -INFINITY;
+}
+
+static void LoudnessCloseSubBlock(LoudnessMeter* lm)
+{
+  size_t at  = lm->subs % LUFS_SHORT_SUBS;
+  double n   = (double)lm->sub_size;
+  double old = lm->subs >= LUFS_SHORT_SUBS ? lm->energy[at] : 0.0;
+
+  // Slide both windows: the short one drops the block LUFS_MOMENTARY_SUBS back
+  if (lm->subs >= LUFS_MOMENTARY_SUBS)
+  {
+    size_t leaving = (lm->subs - LUFS_MOMENTARY_SUBS) % LUFS_SHORT_SUBS;
+    lm->momentary_sum -= lm->energy[leaving];
+    lm->raw_sum[0] -= lm->raw[leaving][0];
+    lm->raw_sum[1] -= lm->raw[leaving][1];
+  }
+  lm->short_sum += lm->sub_energy - old;
+  lm->momentary_sum += lm->sub_energy;
+  lm->raw_sum[0] += lm->sub_raw[0];
+  lm->raw_sum[1] += lm->sub_raw[1];
+  lm->energy[at] = lm->sub_energy;
+  lm->raw[at][0] = lm->sub_raw[0];
+  lm->raw[at][1] = lm->sub_raw[1];
+  lm->peak[at]   = lm->sub_peak;
+  lm->subs++;
+
+  // Running sums may drift a hair below zero after subtracting
+  lm->momentary_sum = lm->momentary_sum > 0.0 ? lm->momentary_sum : 0.0;
+  lm->short_sum     = lm->short_sum > 0.0 ? lm->short_sum : 0.0;
+
+  size_t m_subs = lm->subs < LUFS_MOMENTARY_SUBS ? lm->subs : LUFS_MOMENTARY_SUBS;
+  size_t s_subs = lm->subs < LUFS_SHORT_SUBS ? lm->subs : LUFS_SHORT_SUBS;
+  double m_ms   = lm->momentary_sum / (m_subs * n);
+
+  LoudnessReading* r = &lm->reading;
+  r->momentary       = LoudnessLufs(m_ms);
+  r->short_term      = LoudnessLufs(lm->short_sum / (s_subs * n));
+  double raw_sum     = lm->raw_sum[0] > lm->raw_sum[1] ? lm->raw_sum[0] : lm->raw_sum[1];
+  r->rms             = raw_sum > 0.0 ? 10.0 * log10(raw_sum / (m_subs * n)) : -INFINITY;
+
+  float peak = 0.0f;
+  for (size_t i = 0; i < m_subs; i++)
+  {
+    size_t k = (lm->subs - 1 - i) % LUFS_SHORT_SUBS;
+    peak     = lm->peak[k] > peak ? lm->peak[k] : peak;
+  }
+  r->true_peak = LoudnessDb(peak);
+  if (r->true_peak > r->true_peak_max)
+    r->true_peak_max = r->true_peak;
+
+  // Every full 400 ms block (75% overlap) is a gating block for the integrated loudness
+  if (lm->subs >= LUFS_MOMENTARY_SUBS && r->momentary > LUFS_ABSOLUTE_GATE)
+  {
+    long bin = lround((r->momentary - LUFS_ABSOLUTE_GATE) / LUFS_HIST_STEP);
+    bin      = bin < LUFS_HIST_BINS ? bin : LUFS_HIST_BINS - 1;
+    lm->hist_count[bin]++;
+    lm->hist_energy[bin] += m_ms;
+    r->integrated = LoudnessIntegrated(lm);
+  }
+
+  lm->sub_fill   = 0;
+  lm->sub_energy = 0.0;
+  lm->sub_peak   = 0.0f;
+  memset(lm->sub_raw, 0, sizeof(lm->sub_raw));
+}
+
+void LoudnessProcess(LoudnessMeter* lm, float (*fs)[2], size_t frames)
+{
+  const Biquad* s1 = &lm->shelf;
+  const Biquad* s2 = &lm->highpass;
+
+  for (size_t i = 0; i < frames; i++)
+  {
+    double energy = 0.0;
+    for (int c = 0; c < 2; c++)
+    {
+      // Transposed direct form II, stage 1 then stage 2
+      double x       = fs[i][c];
+      double y1      = s1->b0 * x + lm->z[0][0][c];
+      lm->z[0][0][c] = s1->b1 * x - s1->a1 * y1 + lm->z[0][1][c];
+      lm->z[0][1][c] = s1->b2 * x - s1->a2 * y1;
+      double y2      = s2->b0 * y1 + lm->z[1][0][c];
+      lm->z[1][0][c] = s2->b1 * y1 - s2->a1 * y2 + lm->z[1][1][c];
+      lm->z[1][1][c] = s2->b2 * y1 - s2->a2 * y2;
+      energy += y2 * y2;
+      lm->sub_raw[c] += x * x;
+    }
+    lm->sub_energy += energy;
+
+    // True peak: push into the mirrored ring, then evaluate all four phases
+    size_t at = lm->tp_pos;
+    for (int c = 0; c < 2; c++)
+    {
+      lm->tp_hist[at][c]                  = fs[i][c];
+      lm->tp_hist[at + TRUE_PEAK_TAPS][c] = fs[i][c];
+    }
+    lm->tp_pos = (at + 1) % TRUE_PEAK_TAPS;
+
+    float(*h)[2]       = &lm->tp_hist[lm->tp_pos];
+    float peak         = lm->sub_peak;
+    for (int p = 0; p < 4; p++)
+    {
+      float acc[2] = {0.0f, 0.0f};
+      for (int k = 0; k < TRUE_PEAK_TAPS; k++)
+      {
+        acc[0] += lm->tp_taps[p][k] * h[k][0];
+        acc[1] += lm->tp_taps[p][k] * h[k][1];
+      }
+      peak = fmaxf(peak, fmaxf(fabsf(acc[0]), fabsf(acc[1])));
+    }
+    lm->sub_peak = fmaxf(peak, fmaxf(fabsf(fs[i][0]), fabsf(fs[i][1])));
+
+    if (++lm->sub_fill == lm->sub_size)
+      LoudnessCloseSubBlock(lm);
+  }
+}
+
+/*************************************************************
+ *
+ * @SHARED MEMORY FEED
+ *
+ * Mirrors every published frame into the POSIX shared memory
+ * ring described in raven_shm.h, for other local processes.
+ * The producer side is the audio thread: no syscalls, no
+ * locks, just a seqlock-guarded copy into the next slot.
+ *
+ * The object is created with O_EXCL, so a second rAVen on the
+ * same name refuses instead of writing into the same ring.
+ * Only a leftover from an instance that is no longer running
+ * is taken over.
+ *
+ ************************************************************/
+
+_Static_assert(BANDS_MAX <= RAVEN_SHM_BANDS, "shared memory frames must fit all bands");
+
+RavenShmHeader* _Atomic shm_feed      = NULL; // read by the audio thread, see AnalysisPublish()
+size_t                  shm_feed_size = 0;
+char                    shm_feed_name[64];
+
+/*
+ * Who holds name:
+ *   > 0  the pid of the live rAVen publishing to it
+ *     0  a complete rAVen header whose producer is dead (or the object is gone): may be unlinked
+ *    -1  anything else: too short or without magic, which is also how another instance looks
+ *        between its O_EXCL create and the end of ShmFeedOpen(), so it is left alone
+ */
+static pid_t ShmFeedOwner(const char* name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return errno == ENOENT ? 0 : -1;
+  RavenShmHeader hdr;
+  ssize_t        got = read(fd, &hdr, sizeof(hdr)); // works on Linux tmpfs, no mapping needed
+  close(fd);
+  if (got != (ssize_t)sizeof(hdr) || hdr.magic != RAVEN_SHM_MAGIC || hdr.producer_pid == 0)
+    return -1;
+  pid_t pid = (pid_t)hdr.producer_pid;
+  return kill(pid, 0) == 0 || errno == EPERM ? pid : 0;
+}
+
+int ShmFeedOpen(const char* name)
+{
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0 && errno == EEXIST)
+  {
+    pid_t owner = ShmFeedOwner(name);
+    if (owner != 0)
+    {
+      if (owner > 0)
+        printf("[rAVen] Shared memory %s is in use by rAVen pid %d, pick another --shm=name\n",
+               name, (int)owner);
+      else
+        printf("[rAVen] Shared memory %s exists but is not a finished rAVen feed (being set up, "
+               "or not ours), not touching it; remove /dev/shm%s if it is stale\n",
+               name, name);
+      return -1;
+    }
+    shm_unlink(name); // left behind by an instance that did not exit cleanly
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  if (fd < 0)
+  {
+    printf("[rAVen] Could not open shared memory %s\n", name);
+    return -1;
+  }
+
+  size_t size = sizeof(RavenShmHeader) + RAVEN_SHM_SLOTS * sizeof(RavenShmFrame);
+  void*  base = MAP_FAILED;
+  if (ftruncate(fd, size) == 0)
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+  {
+    printf("[rAVen] Could not size or map shared memory %s\n", name);
+    shm_unlink(name); // it is ours, created above
+    return -1;
+  }
+
+  RavenShmHeader* hdr = base;
+  __atomic_store_n(&hdr->magic, 0, __ATOMIC_RELAXED); // invalid until fully set up
+  memset(base, 0, size);
+  hdr->header_size  = sizeof(RavenShmHeader);
+  hdr->slot_size    = sizeof(RavenShmFrame);
+  hdr->slot_count   = RAVEN_SHM_SLOTS;
+  hdr->bands_max    = RAVEN_SHM_BANDS;
+  hdr->sample_rate  = atomic_load(&analysis_sample_rate);
+  hdr->producer_pid = getpid();
+  hdr->version      = RAVEN_SHM_VERSION;
+  __atomic_store_n(&hdr->magic, RAVEN_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  strncpy(shm_feed_name, name, sizeof(shm_feed_name) - 1);
+  shm_feed_size = size;
+  atomic_store_explicit(&shm_feed, hdr, memory_order_release);
+  printf("[rAVen] Publishing spectrum frames to shared memory %s\n", name);
+  return 0;
+}
+
+void ShmFeedPublish(RavenShmHeader* hdr, const AnalysisFrame* frame)
+{
+  static uint32_t last_beats = 0;
+
+  uint64_t        f    = hdr->write_count; // only this thread writes it
+  RavenShmFrame*  slot = (RavenShmFrame*)((uint8_t*)hdr + hdr->header_size) + f % RAVEN_SHM_SLOTS;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  __atomic_store_n(&slot->seq, 2 * f + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->frame        = f;
+  slot->timestamp_ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+  slot->band_count   = frame->band_count;
+  slot->flags        = frame->beat_count != last_beats ? RAVEN_SHM_FLAG_BEAT : 0;
+  slot->beat_count   = frame->beat_count;
+  slot->peak         = frame->peak;
+  slot->bpm          = frame->bpm;
+  slot->onset        = frame->onset;
+  memcpy(slot->bands, frame->bands, frame->band_count * sizeof(frame->bands[0]));
+  __atomic_store_n(&slot->seq, 2 * f + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&hdr->write_count, f + 1, __ATOMIC_RELEASE);
+
+  last_beats       = frame->beat_count;
+  hdr->sample_rate = atomic_load_explicit(&analysis_sample_rate, memory_order_relaxed);
+}
+
+/* Only once the audio thread is gone */
+void ShmFeedClose(void)
+{
+  RavenShmHeader* hdr = atomic_exchange(&shm_feed, NULL);
+  if (hdr == NULL)
+    return;
+  munmap(hdr, shm_feed_size);
+  shm_unlink(shm_feed_name);
+}
+
+/*************************************************************
+ *
+ * @ANALYSIS CHANNEL
+ *
+ * callback() runs on raylib's audio thread while the render
+ * loop reads on the main thread, so results are handed over
+ * through a small ring of frames guarded by per-slot sequence
+ * numbers (a seqlock). The producer never waits; a reader that
+ * races a write simply sees the sequence change and retries
+ * or falls back to the previous frame.
+ *
+ ************************************************************/
+
+typedef struct
+{
+  _Atomic uint64_t seq; // 2n + 1 while frame n is being written, 2n + 2 once it is complete
+  AnalysisFrame    frame;
+} AnalysisSlot;
+
+AnalysisSlot     analysis_ring[ANALYSIS_RING_SLOTS];
+_Atomic uint64_t analysis_head = 0; // number of frames published
+
+void AnalysisPublish(AnalysisFrame* frame)
+{
+  uint64_t      n    = atomic_load_explicit(&analysis_head, memory_order_relaxed);
+  AnalysisSlot* slot = &analysis_ring[n % ANALYSIS_RING_SLOTS];
+
+  frame->seq  = n + 1;
+  frame->time = now_seconds();
+  atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  slot->frame = *frame;
+  atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+  atomic_store_explicit(&analysis_head, n + 1, memory_order_release);
+
+  RavenShmHeader* feed = atomic_load_explicit(&shm_feed, memory_order_acquire);
+  if (feed != NULL)
+    ShmFeedPublish(feed, frame);
+}
+
+/* Copies frame number n (1-based) if it is still in the ring */
+bool AnalysisRead(uint64_t n, AnalysisFrame* frame)
+{
+  if (n == 0)
+    return false;
+  AnalysisSlot* slot = &analysis_ring[(n - 1) % ANALYSIS_RING_SLOTS];
+  uint64_t      s1   = atomic_load_explicit(&slot->seq, memory_order_acquire);
+  if (s1 != 2 * n)
+    return false;
+  *frame = slot->frame;
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&slot->seq, memory_order_relaxed) == s1;
+}
+
+bool AnalysisReadLatest(AnalysisFrame* frame)
+{
+  for (int attempt = 0; attempt < 4; attempt++)
+  {
+    if (AnalysisRead(atomic_load_explicit(&analysis_head, memory_order_acquire), frame))
+      return true;
+  }
+  return false;
+}
+
+/*************************************************************
+ *
+ * @LATENCY COMPENSATION
+ *
+ * callback() sees samples when the mixer hands them to the
+ * device, not when they come out of the speakers: the device
+ * still has a few periods queued in front of them. Drawing
+ * the newest frame therefore makes the bars lead the sound.
+ *
+ * Every frame carries the stream position at the end of its
+ * block and the time it was published. From the newest one
+ * the render loop extrapolates the stream position that is
+ * audible right now,
+ *
+ *   audible = position + (now - time) - latency
+ *
+ * and finds the newest frame at or before it, walking back
+ * through the analysis ring, which doubles as the render-side
+ * queue (ANALYSIS_RING_SLOTS frames, a few hundred ms). The
+ * bands are then blended towards the next frame by where
+ * audible falls between the two (see @RENDER PACING).
+ *
+ * latency = automatic estimate + manual offset ([ and ] keys,
+ * --av-offset). The estimate comes from callback(): the mixer
+ * runs it in one burst per device period, so the period size
+ * is measured from the bursts, times the number of periods
+ * the device keeps queued.
+ *
+ * $PERIOD COUNT
+ *
+ * That count is in miniaudio's ma_device, which raylib keeps
+ * private (no API returns the device or its config), so it
+ * cannot be read back. InitAudioDevice() asks for miniaudio's
+ * default of 3 (MA_DEFAULT_PERIODS) and most backends grant
+ * it, so LATENCY_PERIODS assumes 3. Backends that negotiate a
+ * different count (some ALSA setups, JACK) can pass the real
+ * one with --device-periods=<n>.
+ *
+ ************************************************************/
+
+_Atomic float output_latency = 0.0f; // automatic estimate in seconds, written by callback()
+
+/* Feeds the device period estimate; start is when this callback() began */
+void LatencyObserveBlock(double start, unsigned frames, unsigned rate)
+{
+  static double   last_end     = 0.0;
+  static unsigned burst_frames = 0;
+  static double   period       = 0.0;
+
+  if (start - last_end > LATENCY_BURST_GAP && burst_frames > 0 && rate > 0)
+  {
+    // A new device period started, the previous burst was one whole period
+    double p = (double)burst_frames / rate;
+    period   = period > 0.0 ? period + 0.05 * (p - period) : p;
+    atomic_store_explicit(&output_latency, (float)(period * devicePeriods),
+                          memory_order_relaxed);
+    burst_frames = 0;
+  }
+  burst_frames += frames;
+  last_end = now_seconds();
+}
+
+/* Moves frame's bands towards later's, in proportion to where position at falls between them */
+void AnalysisInterpolate(AnalysisFrame* frame, const AnalysisFrame* later, double at)
+{
+  double span = later->position - frame->position;
+  if (span <= 0.0 || later->band_count != frame->band_count) // track or layout change
+    return;
+  float t = (float)((at - frame->position) / span);
+  for (size_t i = 0; i < frame->band_count; i++)
+  {
+    frame->bands[i] += t * (later->bands[i] - frame->bands[i]);
+  }
+  frame->peak += t * (later->peak - frame->peak);
+  frame->position = at;
+}
+
+/* Spectrum audible at time now, given the total output latency, interpolated between hops */
+bool AnalysisReadAudible(double now, double latency, AnalysisFrame* frame)
+{
+  AnalysisFrame newest;
+  if (!AnalysisReadLatest(&newest))
+    return false;
+
+  // Extrapolate only a little past the newest block (e.g. not through a pause)
+  double elapsed = now - newest.time;
+  if (elapsed < 0.0)
+    elapsed = 0.0;
+  if (elapsed > LATENCY_EXTRAPOLATE)
+    elapsed = LATENCY_EXTRAPOLATE;
+  double audible = newest.position + elapsed - latency;
+
+  AnalysisFrame later = newest;
+  *frame              = newest;
+  for (uint64_t n = newest.seq - 1; frame->position > audible && n > 0 &&
+                                    newest.seq - n < ANALYSIS_RING_SLOTS;
+       n--)
+  {
+    AnalysisFrame older;
+    // Stop at frames already overwritten or from before a track change (position jumps back up)
+    if (!AnalysisRead(n, &older) || older.position > frame->position)
+      break;
+    later  = *frame;
+    *frame = older;
+  }
+
+  // Past the newest frame there is nothing to blend towards, it is simply held
+  if (frame->position <= audible && later.seq != frame->seq)
+    AnalysisInterpolate(frame, &later, audible);
+  return true;
+}
+
+/* Appends count samples to an N-sample history, shifting it once per block */
+void PushHistory(float* hist, const float* xs, size_t count)
+{
+  if (count >= N)
+  {
+    memcpy(hist, xs + count - N, N * sizeof(hist[0]));
+    return;
+  }
+  memmove(hist, hist + count, (N - count) * sizeof(hist[0]));
+  memcpy(hist + N - count, xs, count * sizeof(hist[0]));
+}
+
+/*************************************************************
+ *
+ * @QUALITY GOVERNOR
+ *
+ * Frame cost depends on mode, resolution and machine, so
+ * instead of a fixed amount of work per frame the render loop
+ * watches how long each frame's work takes (everything up to
+ * EndDrawing(), so vsync waits do not count) and how much of
+ * real time the audio thread spends in callback(), and steps
+ * through qualityLevels:
+ *
+ * -> over budget for ~0.5 s   : one level down
+ * -> well under for ~3 s      : one level back up
+ *
+ * The asymmetric hold times keep it from oscillating between
+ * two levels. Each level trades band count, FFT size,
+ * RADIAL_BARS smoothing and GeomCoolRectangle() decoration.
+ *
+ ************************************************************/
+
+typedef struct
+{
+  const char* name;
+  float       band_step; // larger step -> fewer bands
+  size_t      fft_size;
+  bool        smoothing;   // RADIAL_BARS temporal smoothing
+  bool        decorations; // outline + accent circle in GeomCoolRectangle()
+} QualityLevel;
+
+const QualityLevel qualityLevels[] = {
+  {"high", BAND_STEP, N, true, true},
+  {"medium", BAND_STEP, N / 2, true, false},
+  {"low", 1.09f, N / 4, true, false},
+  {"lowest", 1.12f, N / 8, false, false},
+};
+
+typedef struct
+{
+  bool  enabled;
+  int   level;
+  float budget;    // seconds of work allowed per frame
+  float work_avg;  // smoothed frame work time
+  int   over_run;  // consecutive frames over budget
+  int   under_run; // consecutive frames with headroom
+} QualityGovernor;
+
+void GovernorUpdate(QualityGovernor* gov, float work_seconds, float load)
+{
+  if (!gov->enabled)
+    return;
+
+  gov->work_avg += 0.1f * (work_seconds - gov->work_avg);
+
+  bool over  = gov->work_avg > 0.85f * gov->budget || load > 0.5f;
+  bool under = gov->work_avg < 0.5f * gov->budget && load < 0.25f;
+  gov->over_run  = over ? gov->over_run + 1 : 0;
+  gov->under_run = under ? gov->under_run + 1 : 0;
+
+  int levels = ARRAY_LEN(qualityLevels);
+  if (gov->over_run >= 30 && gov->level + 1 < levels)
+  {
+    gov->level++;
+    gov->over_run = 0;
+  }
+  else if (gov->under_run >= 180 && gov->level > 0)
+  {
+    gov->level--;
+    gov->under_run = 0;
+  }
+  atomic_store(&quality_level, gov->level);
+}
+
+/*************************************************************
+ *
+ * @TIMING HISTOGRAMS
+ *
+ * For --soak (see @SOAK TEST): callback() and the render
+ * loop drop every duration into a log-spaced histogram,
+ * SOAK_HIST_STEPS bins per octave of microseconds (~9%
+ * resolution), and the soak driver drains them once per
+ * sample to get that interval's percentiles. Recording is a
+ * relaxed atomic increment, cheap enough for the audio thread.
+ *
+ ************************************************************/
+
+typedef struct
+{
+  _Atomic uint32_t bins[SOAK_HIST_BINS];
+} TimingHistogram;
+
+_Atomic bool    timingEnabled  = false;
+TimingHistogram callbackTimes  = {0};
+TimingHistogram frameWorkTimes = {0};
+
+void TimingRecord(TimingHistogram* h, double seconds)
+{
+  double us  = seconds * 1e6;
+  int    bin = us < 1.0 ? 0 : 1 + (int)(log2(us) * SOAK_HIST_STEPS);
+  if (bin >= SOAK_HIST_BINS)
+    bin = SOAK_HIST_BINS - 1;
+  atomic_fetch_add_explicit(&h->bins[bin], 1, memory_order_relaxed);
+}
+
+/* Bin centre in seconds */
+static double TimingBinValue(int bin)
+{
+  return bin == 0 ? 0.5e-6 : exp2((bin - 0.5) / SOAK_HIST_STEPS) * 1e-6;
+}
+
+/* Empties h into counts; returns the number of recorded durations */
+uint64_t TimingDrain(TimingHistogram* h, uint32_t counts[SOAK_HIST_BINS])
+{
+  uint64_t total = 0;
+  for (int i = 0; i < SOAK_HIST_BINS; i++)
+  {
+    counts[i] = atomic_exchange_explicit(&h->bins[i], 0, memory_order_relaxed);
+    total += counts[i];
+  }
+  return total;
+}
+
+/* The q-quantile (0..1) in seconds of drained counts, 0 if empty */
+double TimingPercentile(const uint32_t counts[SOAK_HIST_BINS], uint64_t total, double q)
+{
+  if (total == 0)
+    return 0.0;
+  uint64_t rank = (uint64_t)ceil(q * total), seen = 0;
+  for (int i = 0; i < SOAK_HIST_BINS; i++)
+  {
+    seen += counts[i];
+    if (seen >= rank && counts[i] > 0)
+      return TimingBinValue(i);
+  }
+  return TimingBinValue(SOAK_HIST_BINS - 1);
+}
+
+/*************************************************************
+ *
+ * @CALLBACK
+ *
+ * Runs on the audio thread for every block raylib mixes.
+ * Configuration coming from the main thread (sample rate,
+ * decimation factor) is picked up here so that the filter
+ * and band state is only ever touched by this thread.
+ *
+ ************************************************************/
+
+/* Feeds frames stereo samples to the meters and the mono histories (or the resonator bank) */
+void AnalyzeIngest(float (*fs)[2], size_t frames, LoudnessMeter* loudness, ResonatorBank* bank,
+                   int stages)
+{
+  // Level meters see the stereo signal, independent of engine and quality
+  LoudnessProcess(loudness, fs, frames);
+
+  // Mix down in chunks so both histories are shifted once per chunk, not once per sample
+  float mono[512];
+  float low[512 / 2];
+  for (size_t done = 0; done < frames;)
+  {
+    size_t chunk     = frames - done < ARRAY_LEN(mono) ? frames - done : ARRAY_LEN(mono);
+    size_t low_count = 0;
+    for (size_t i = 0; i < chunk; i++)
+    {
+      mono[i] = (fs[done + i][0] + fs[done + i][1]) / 2;
+    }
+    if (bank != NULL)
+    {
+      ResonatorBankProcess(bank, mono, chunk);
+      done += chunk;
+      continue;
+    }
+    for (size_t i = 0; stages && i < chunk; i++)
+    {
+      if (DecimatePush(mono[i], stages, &low[low_count]))
+        low_count++;
+    }
+    PushHistory(in, mono, chunk);
+    PushHistory(low_in, low, low_count);
+    done += chunk;
+  }
+}
+
+void AnalyzeBlock(float (*fs)[2], unsigned int frames)
+{
+  static BandLayout    layout;
+  static DecimAligner  aligner;
+  static ResonatorBank bank;
+  static BeatTracker   beats;
+  static LoudnessMeter loudness;
+  static unsigned      layout_rate   = 0;
+  static int           decimation    = 0;
+  static int           engine        = -1;
+  static int           quality       = -1;
+  static unsigned      epoch         = 0;
+  static unsigned      stream        = 0;
+  static uint64_t      analyzed      = 0; // frames of this stream so far, for frame.position
+  static size_t        pending       = 0; // frames taken in since the last published hop
+
+  unsigned rate = atomic_load_explicit(&analysis_sample_rate, memory_order_relaxed);
+  int      dec  = atomic_load_explicit(&requested_decimation, memory_order_relaxed);
+  int      eng  = atomic_load_explicit(&requested_engine, memory_order_relaxed);
+  int      q    = atomic_load_explicit(&quality_level, memory_order_relaxed);
+  unsigned e    = atomic_load_explicit(&analysis_epoch, memory_order_relaxed);
+  unsigned st   = atomic_load_explicit(&analysis_stream, memory_order_relaxed);
+
+  bool restart = e != epoch;
+  if (restart)
+  {
+    // Forget everything heard so far; the checks below then rebuild layout, filters and bank
+    memset(in, 0, sizeof(in));
+    memset(&beats, 0, sizeof(beats));
+    analyzed = 0;
+    pending  = 0;
+    epoch    = e;
+  }
+
+  const QualityLevel* level = &qualityLevels[q];
+  if (restart || rate != layout_rate || dec != decimation || q != quality)
+  {
+    BuildBandLayout(&layout, rate, dec, level->band_step, level->fft_size);
+    ResetDecimation();
+    decimation    = dec;
+    aligner.count = 0;
+  }
+  if (restart || rate != layout_rate || eng != engine || q != quality)
+  {
+    InitResonatorBank(&bank, rate, level->band_step);
+    engine = eng;
+  }
+  if (rate != layout_rate || st != stream)
+  {
+    InitLoudnessMeter(&loudness, rate);
+    stream = st;
+  }
+  else if (restart)
+  {
+    LoudnessSeek(&loudness); // same track, so integrated loudness carries on
+  }
+  layout_rate = rate;
+  quality     = q;
+  size_t n    = layout.fft_size;
+  int stages  = dec >= 8 ? 3 : dec >= 4 ? 2 : dec >= 2 ? 1 : 0;
+
+  // Take samples in as they come, but publish a frame every ANALYSIS_HOP frames whatever the
+  // device block size, so frames are evenly spaced in stream time (see @RENDER PACING)
+  for (size_t done = 0; done < frames;)
+  {
+    size_t span = frames - done;
+    if (span > ANALYSIS_HOP - pending)
+      span = ANALYSIS_HOP - pending;
+    AnalyzeIngest(fs + done, span, &loudness, engine == ENGINE_RESONATOR ? &bank : NULL, stages);
+    done += span;
+    pending += span;
+    analyzed += span;
+    if (pending < ANALYSIS_HOP)
+      continue;
+    pending = 0;
+
+    AnalysisFrame frame;
+    double        hop_seconds = rate > 0 ? (double)ANALYSIS_HOP / rate : 0.0;
+    frame.position            = rate > 0 ? (double)analyzed / rate : 0.0;
+    frame.loudness            = loudness.reading;
+    if (engine == ENGINE_RESONATOR)
+    {
+      ResonatorBankBands(&bank, &frame);
+      BeatTrackerUpdate(&beats, &frame, hop_seconds);
+      AnalysisPublish(&frame);
+      continue;
+    }
+
+    // Lower quality levels transform only the newest n samples
+    fft(in + N - n, 1, out, n);
+
+    // Every hop: skipping hops on the slower stream would add up to D - 1 hops of jitter to
+    // the bass bands on top of the alignment delay (see $ALIGNMENT)
+    if (stages)
+      fft(low_in + N - n, 1, low_out, n);
+
+    ComputeBands(&layout, out, low_out, &frame);
+    if (stages && !DecimAlign(&aligner, &layout, DecimAlignHops(dec, n), &frame))
+      continue;
+    BeatTrackerUpdate(&beats, &frame, hop_seconds);
+    AnalysisPublish(&frame);
+  }
+}
+
+// Time to first audio for --startup-stats: until the decoder is fed, streams play silence
+void NoteFirstAudio(const float (*fs)[2], unsigned int frames, double when)
+{
+  for (unsigned int i = 0; i < frames; i++)
+  {
+    if (fs[i][0] != 0.0f || fs[i][1] != 0.0f)
+    {
+      first_audio_time = when;
+      atomic_store_explicit(&first_audio_seen, true, memory_order_release);
+      return;
+    }
+  }
+}
+
+void callback(void* bufferData, unsigned int frames)
+{
+  static double load = 0.0;
+
+  double start = now_seconds();
+  AnalyzeBlock(bufferData, frames);
+  if (!atomic_load_explicit(&first_audio_seen, memory_order_relaxed))
+    NoteFirstAudio(bufferData, frames, start);
+
+  unsigned rate = atomic_load_explicit(&analysis_sample_rate, memory_order_relaxed);
+  LatencyObserveBlock(start, frames, rate);
+  if (atomic_load_explicit(&timingEnabled, memory_order_relaxed))
+    TimingRecord(&callbackTimes, now_seconds() - start);
+
+  // Fraction of the block's real-time duration spent analyzing it, smoothed
+  if (frames > 0 && rate > 0)
+  {
+    load += 0.05 * ((now_seconds() - start) * rate / frames - load);
+    atomic_store_explicit(&analysis_load, (float)load, memory_order_relaxed);
+  }
+}
+
+/* New stream: callback() starts over at the given rate */
+void RestartAnalysis(unsigned rate)
+{
+  atomic_store(&analysis_sample_rate, rate);
+  atomic_fetch_add(&analysis_stream, 1);
+  atomic_fetch_add(&analysis_epoch, 1); // positions start over
+}
+
+/* Seek: like a new stream, except that integrated loudness and max true peak carry on */
+void SeekAnalysis(void) { atomic_fetch_add(&analysis_epoch, 1); }
+
+void AttachAnalysis(AudioStream stream)
+{
+  RestartAnalysis(stream.sampleRate);
+  AttachAudioStreamProcessor(stream, callback);
+}
+
+/* The extension is only a first filter; it has to end the name, so "notes.mp3.txt" is no song */
+bool HasSongExtension(const char* filename)
+{
+  const char* extensions[] = {".mp3", ".wav", ".flac", ".aac", ".ogg", NULL};
+  const char* dot          = strrchr(filename, '.');
+  if (dot == NULL)
+    return false;
+  for (int i = 0; extensions[i] != NULL; i++)
+  {
+    if (strcasecmp(dot, extensions[i]) == 0)
+      return true;
+  }
+  return false;
+}
+
+/* A libmagic cookie reporting MIME types, or NULL (then only extensions are checked) */
+magic_t AudioMagicOpen(void)
+{
+  magic_t cookie = magic_open(MAGIC_MIME_TYPE | MAGIC_ERROR);
+  if (cookie != NULL && magic_load(cookie, NULL) != 0)
+  {
+    printf("[rAVen] libmagic: %s, trusting file extensions\n", magic_error(cookie));
+    magic_close(cookie);
+    cookie = NULL;
+  }
+  return cookie;
+}
+
+/* The MIME type of path if its content is audio, else NULL; a NULL cookie accepts everything */
+const char* AudioSniff(magic_t cookie, const char* path)
+{
+  if (cookie == NULL)
+    return "audio/unknown";
+  const char* type = magic_file(cookie, path);
+  if (type == NULL)
+    return NULL;
+  if (strncmp(type, "audio/", 6) == 0 || strcmp(type, "application/ogg") == 0 ||
+      strcmp(type, "video/ogg") == 0)
+    return type;
+  return NULL;
+}
+
+/* Main thread only: the cookie is not thread safe and the library scanner has its own */
+int is_song_file(const char* filename)
+{
+  static magic_t cookie = NULL;
+  static bool    opened = false;
+  if (!HasSongExtension(filename))
+    return 0;
+  if (!opened)
+  {
+    cookie = AudioMagicOpen();
+    opened = true;
+  }
+  return AudioSniff(cookie, filename) != NULL;
+}
+
+// Function to check if the mouse is hovering over a rectangle (used for the info button)
+bool IsMouseOverRectangle(Rectangle rect)
+{
+  Vector2 mouse = GetMousePosition();
+  return CheckCollisionPointRec(mouse, rect);
+}
+
+/*************************************************************
+ *
+ * @IDLE-AWARE RENDERING
+ *
+ * Redrawing at full rate only makes sense while something on
+ * screen moves. Every loop iteration main() picks one of:
+ *
+ * -> paused            : block in raylib's event waiting, so the
+ *                        loop only wakes up on input
+ * -> minimized/hidden  : nothing is drawn, the loop just keeps
+ *                        the music stream fed at a low rate
+ * -> unfocused         : drawn at IDLE_FPS only; in between the
+ *                        loop keeps feeding the stream every
+ *                        IDLE_POLL_SECONDS like when hidden
+ * -> unchanged         : no new spectrum, no input and the time
+ *                        display has not ticked: skip the frame
+ *
+ * and goes straight back to full rate once playback resumes.
+ *
+ ************************************************************/
+
+// Any key, mouse, wheel, drop or resize activity since the last poll
+bool InputActivity(void)
+{
+  Vector2 delta = GetMouseDelta();
+  return GetKeyPressed() != 0 || delta.x != 0.0f || delta.y != 0.0f ||
+         GetMouseWheelMove() != 0.0f || IsMouseButtonDown(MOUSE_LEFT_BUTTON) ||
+         IsFileDropped() || IsWindowResized();
+}
+
+bool SpectrumChanged(const AnalysisFrame* a, const AnalysisFrame* b)
+{
+  if (a->band_count != b->band_count || a->beat_count != b->beat_count)
+    return true;
+  return memcmp(a->bands, b->bands, a->band_count * sizeof(a->bands[0])) != 0;
+}
+
+/*************************************************************
+ *
+ * @RENDER PACING
+ *
+ * Analysis and rendering run at their own rates. The audio
+ * thread publishes a frame every ANALYSIS_HOP stream frames
+ * (~86 a second at 44.1 kHz), however the device slices its
+ * blocks, and the render loop runs at the display's refresh
+ * rate with vsync. Each rendered frame blends the two
+ * analysis frames around the audible position (see
+ * AnalysisReadAudible()), so a 144 Hz display gets 144
+ * distinct spectra a second without a single extra FFT, and
+ * a slow renderer never holds up the analysis.
+ *
+ * SetTargetFPS() stays at twice the refresh rate; it only
+ * matters if the driver ignores the vsync hint. Idle states
+ * skip frames instead of lowering it (see @IDLE-AWARE
+ * RENDERING), so the stream is still fed on time.
+ *
+ ************************************************************/
+
+int DisplayRefreshRate(void)
+{
+  int hz = GetMonitorRefreshRate(GetCurrentMonitor());
+  return hz > 0 ? hz : TARGET_FPS;
+}
+
+/* Only a safety net above the display rate, which is left to vsync */
+void SetFramePace(int displayFps) { SetTargetFPS(2 * displayFps); }
+
+/*************************************************************
+ *
+ * @FILE DIALOG
+ *
+ * GTK is only needed once somebody presses 'f', so it is not
+ * linked any more: libgtk-3 pulls in a few dozen shared
+ * objects that the dynamic loader would otherwise map and
+ * relocate before main() even starts. GtkLoad() dlopen()s it
+ * on first use and resolves the handful of calls below; the
+ * header is still used for the types and constants.
+ *
+ ************************************************************/
+
+typedef struct
+{
+  void* handle;
+  bool  failed;
+  gboolean (*init_check)(int*, char***);
+  GtkWidget* (*file_chooser_dialog_new)(const gchar*, GtkWindow*, GtkFileChooserAction,
+                                        const gchar*, ...);
+  gint (*dialog_run)(GtkDialog*);
+  gchar* (*file_chooser_get_filename)(GtkFileChooser*);
+  void (*widget_destroy)(GtkWidget*);
+  gboolean (*events_pending)(void);
+  gboolean (*main_iteration)(void);
+  void (*free)(gpointer);
+} GtkApi;
+
+GtkApi gtk = {0};
+
+bool GtkResolve(const char* name, void** fn)
+{
+  *fn = dlsym(gtk.handle, name);
+  if (*fn == NULL)
+    printf("[rAVen] GTK has no %s\n", name);
+  return *fn != NULL;
+}
+
+// Loads and initializes GTK on the first call, false if it is unavailable
+bool GtkLoad(void)
+{
+  if (gtk.handle != NULL || gtk.failed)
+    return !gtk.failed;
+
+  gtk.handle = dlopen("libgtk-3.so.0", RTLD_NOW | RTLD_LOCAL);
+  if (gtk.handle == NULL)
+  {
+    printf("[rAVen] Could not load GTK: %s\n", dlerror());
+    gtk.failed = true;
+    return false;
+  }
+
+  // g_free lives in glib, which dlsym() finds through GTK's dependencies
+  gtk.failed = !(GtkResolve("gtk_init_check", (void**)&gtk.init_check) &&
+                 GtkResolve("gtk_file_chooser_dialog_new", (void**)&gtk.file_chooser_dialog_new) &&
+                 GtkResolve("gtk_dialog_run", (void**)&gtk.dialog_run) &&
+                 GtkResolve("gtk_file_chooser_get_filename",
+                            (void**)&gtk.file_chooser_get_filename) &&
+                 GtkResolve("gtk_widget_destroy", (void**)&gtk.widget_destroy) &&
+                 GtkResolve("gtk_events_pending", (void**)&gtk.events_pending) &&
+                 GtkResolve("gtk_main_iteration", (void**)&gtk.main_iteration) &&
+                 GtkResolve("g_free", (void**)&gtk.free));
+
+  // Initialize GTK only once, before the first dialog
+  if (!gtk.failed && !gtk.init_check(0, NULL))
+  {
+    printf("Failed to initialize GTK!\n");
+    gtk.failed = true;
+  }
+  return !gtk.failed;
+}
+
+// Function to open a GTK file dialog and update the selected_song path
+void OpenFileDialog()
+{
+  GtkWidget*           dialog;
+  GtkFileChooser*      chooser;
+  GtkFileChooserAction action = GTK_FILE_CHOOSER_ACTION_OPEN;
+
+  if (!GtkLoad())
+  {
+    return;
+  }
+
+  dialog = gtk.file_chooser_dialog_new("Open File", NULL, action, "_Cancel", GTK_RESPONSE_CANCEL,
+                                       "_Open", GTK_RESPONSE_ACCEPT, NULL);
+
+  // Plain casts: GTK_FILE_CHOOSER() and GTK_DIALOG() would call into the library at link time
+  chooser = (GtkFileChooser*)dialog;
+
+  // Process the dialog event in a non-blocking way
+  if (gtk.dialog_run((GtkDialog*)dialog) == GTK_RESPONSE_ACCEPT)
+  {
+    char* file_name = gtk.file_chooser_get_filename(chooser);
+    strncpy(selected_song, file_name, sizeof(selected_song) - 1);
+    selected_song[sizeof(selected_song) - 1] = '\0'; // Null-terminate string
+    gtk.free(file_name);
+  }
+
+  // Destroy the dialog widget after the response
+  gtk.widget_destroy(dialog);
+
+  // Ensure any pending GTK events are processed
+  while (gtk.events_pending())
+  {
+    gtk.main_iteration();
+  }
+}
+
+/*************************************************************
+ *
+ * @FRAME GEOMETRY
+ *
+ * handleVisualization() does all the per-band math (bar
+ * rectangles, ray end points, colors) but does not draw: it
+ * emits plain colored vertices, the same triangles and lines
+ * raylib's shape functions would, into a FrameGeometry.
+ * SubmitGeometry() then hands them to rlgl in one loop.
+ *
+ * Consecutive primitives of the same kind share a GeomBatch,
+ * so the submit side does no math and almost no branching.
+ *
+ ************************************************************/
+
+typedef struct
+{
+  float x, y;
+  Color color;
+} GeomVertex;
+
+typedef struct
+{
+  int    mode;  // RL_TRIANGLES or RL_LINES
+  size_t first; // index into FrameGeometry.verts
+  size_t count;
+} GeomBatch;
+
+typedef struct
+{
+  GeomVertex verts[GEOM_VERTS_MAX];
+  size_t     vert_count;
+  GeomBatch  batches[GEOM_BATCHES_MAX];
+  size_t     batch_count;
+  bool       decorations; // see GeomCoolRectangle()
+} FrameGeometry;
+
+/* Everything handleVisualization() reads, copied so the builder never touches main thread state */
+typedef struct
+{
+  AnalysisFrame     frame;
+  float             beatPulse;
+  int               width;
+  int               height;
+  VisualizationMode mode;
+  bool              decorations;
+  bool              smoothing;
+  float             frameTime; // seconds since the previous frame, for rate-independent smoothing
+} GeometryInput;
+
+/* Room for count vertices of the given mode, NULL once the buffer is full (the rest is dropped) */
+static GeomVertex* GeomReserve(FrameGeometry* geom, int mode, size_t count)
+{
+  if (geom->vert_count + count > GEOM_VERTS_MAX)
+    return NULL;
+
+  GeomBatch* batch = geom->batch_count ? &geom->batches[geom->batch_count - 1] : NULL;
+  if (batch == NULL || batch->mode != mode)
+  {
+    if (geom->batch_count == GEOM_BATCHES_MAX)
+      return NULL;
+    batch  = &geom->batches[geom->batch_count++];
+    *batch = (GeomBatch){mode, geom->vert_count, 0};
+  }
+  GeomVertex* v = &geom->verts[geom->vert_count];
+  geom->vert_count += count;
+  batch->count += count;
+  return v;
+}
+
+/* Culling keeps raylib's winding (counter-clockwise on screen), so fix up the order here */
+void GeomTriangle(FrameGeometry* geom, Vector2 a, Vector2 b, Vector2 c, Color color)
+{
+  GeomVertex* v = GeomReserve(geom, RL_TRIANGLES, 3);
+  if (v == NULL)
+    return;
+  if ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) > 0.0f)
+  {
+    Vector2 t = b;
+    b         = c;
+    c         = t;
+  }
+  v[0] = (GeomVertex){a.x, a.y, color};
+  v[1] = (GeomVertex){b.x, b.y, color};
+  v[2] = (GeomVertex){c.x, c.y, color};
+}
+
+void GeomLine(FrameGeometry* geom, Vector2 a, Vector2 b, Color color)
+{
+  GeomVertex* v = GeomReserve(geom, RL_LINES, 2);
+  if (v == NULL)
+    return;
+  v[0] = (GeomVertex){a.x, a.y, color};
+  v[1] = (GeomVertex){b.x, b.y, color};
+}
+
+void GeomRectangle(FrameGeometry* geom, float x, float y, float width, float height, Color color)
+{
+  Vector2 tl = {x, y}, bl = {x, y + height}, br = {x + width, y + height}, tr = {x + width, y};
+  GeomTriangle(geom, tl, bl, br, color);
+  GeomTriangle(geom, tl, br, tr, color);
+}
+
+/* Same outline as DrawRectangleLines(), which is inset by one pixel on the top-left edges */
+void GeomRectangleLines(FrameGeometry* geom, float x, float y, float width, float height,
+                        Color color)
+{
+  Vector2 tl = {x + 1, y + 1}, tr = {x + width, y + 1};
+  Vector2 br = {x + width, y + height}, bl = {x + 1, y + height};
+  GeomLine(geom, tl, tr, color);
+  GeomLine(geom, tr, br, color);
+  GeomLine(geom, br, bl, color);
+  GeomLine(geom, bl, tl, color);
+}
+
+/* Thick line as a quad, like DrawLineEx() */
+void GeomLineEx(FrameGeometry* geom, Vector2 a, Vector2 b, float thick, Color color)
+{
+  float dx = b.x - a.x, dy = b.y - a.y;
+  float len = sqrtf(dx * dx + dy * dy);
+  if (len <= 0.0f)
+    return;
+  float   px = -dy / len * thick / 2, py = dx / len * thick / 2;
+  Vector2 a0 = {a.x + px, a.y + py}, a1 = {a.x - px, a.y - py};
+  Vector2 b0 = {b.x + px, b.y + py}, b1 = {b.x - px, b.y - py};
+  GeomTriangle(geom, a0, a1, b1, color);
+  GeomTriangle(geom, a0, b1, b0, color);
+}
+
+void GeomCircle(FrameGeometry* geom, Vector2 center, float radius, Color color)
+{
+  for (int s = 0; s < GEOM_CIRCLE_SEGS; s++)
+  {
+    float   a0 = 2 * pi * s / GEOM_CIRCLE_SEGS;
+    float   a1 = 2 * pi * (s + 1) / GEOM_CIRCLE_SEGS;
+    Vector2 p0 = {center.x + cosf(a0) * radius, center.y + sinf(a0) * radius};
+    Vector2 p1 = {center.x + cosf(a1) * radius, center.y + sinf(a1) * radius};
+    GeomTriangle(geom, center, p0, p1, color);
+  }
+}
+
+void GeomCircleLines(FrameGeometry* geom, Vector2 center, float radius, Color color)
+{
+  for (int s = 0; s < GEOM_CIRCLE_SEGS; s++)
+  {
+    float a0 = 2 * pi * s / GEOM_CIRCLE_SEGS;
+    float a1 = 2 * pi * (s + 1) / GEOM_CIRCLE_SEGS;
+    GeomLine(geom, (Vector2){center.x + cosf(a0) * radius, center.y + sinf(a0) * radius},
+             (Vector2){center.x + cosf(a1) * radius, center.y + sinf(a1) * radius}, color);
+  }
+}
+
+// Bar with an outline and an accent circle (the latter two dropped by the quality governor)
+void GeomCoolRectangle(FrameGeometry* geom, float x, float y, float width, float height,
+                       Color color)
+{
+  GeomRectangle(geom, x, y, width, height, color);
+  if (!geom->decorations)
+    return;
+  GeomRectangleLines(geom, x, y, width, height, ColorAlpha(color, 0.3f));
+  GeomCircle(geom, (Vector2){x + width / 2, y}, width / 4, ColorAlpha(color, 0.2f));
+}
+
+/* Main thread only: replays the vertices through rlgl in chunks that fit its render batch */
+void SubmitGeometry(const FrameGeometry* geom)
+{
+  for (size_t b = 0; b < geom->batch_count; b++)
+  {
+    const GeomBatch* batch = &geom->batches[b];
+    for (size_t done = 0; done < batch->count;)
+    {
+      size_t chunk = batch->count - done;
+      if (chunk > GEOM_SUBMIT_CHUNK)
+        chunk = GEOM_SUBMIT_CHUNK;
+
+      rlCheckRenderBatchLimit((int)chunk);
+      rlBegin(batch->mode);
+      for (size_t i = batch->first + done; i < batch->first + done + chunk; i++)
+      {
+        const GeomVertex* v = &geom->verts[i];
+        rlColor4ub(v->color.r, v->color.g, v->color.b, v->color.a);
+        rlVertex2f(v->x, v->y);
+      }
+      rlEnd();
+      done += chunk;
+    }
+  }
+}
+
+/*************************************************************
+ *
+ * @VISUALIZATION MODES
+ *
+ * Every mode is an entry in visualizationModes[] that owns a
+ * preallocated state struct and four hooks, all run by the
+ * geometry builder (see @GEOMETRY PIPELINE):
+ *
+ * -> init   : whenever the mode becomes current, so its
+ *             state never carries over from the last time it
+ *             was shown
+ * -> resize : after init and whenever the window size changes
+ * -> update : once per frame while current, advances the
+ *             mode's own state (smoothing, cached angles)
+ * -> draw   : once per frame, emits the mode's geometry
+ *
+ * handleVisualization() normalizes the bands once and calls
+ * the current mode's update and draw, so dispatch happens
+ * once per frame rather than once per band, and every mode
+ * shows up as its own functions in a profile. Adding a mode
+ * is an enum value, a state struct and a table entry.
+ *
+ ************************************************************/
+
+/* The spectrum as every mode sees it */
+typedef struct
+{
+  float  amplitudes[BANDS_MAX]; // bands normalized to the frame peak
+  size_t count;
+  float  beatPulse;
+  bool   smoothing;
+  float  frameTime;
+} ModeFrame;
+
+typedef struct
+{
+  void* state;
+  void (*init)(void* state);
+  void (*resize)(void* state, int width, int height);
+  void (*update)(void* state, const ModeFrame* frame);
+  void (*draw)(const void* state, const ModeFrame* frame, FrameGeometry* geom);
+} VisualizationModeOps;
+
+/* Band angles around the center, recomputed only when the band count changes */
+typedef struct
+{
+  size_t count;
+  float  cos[BANDS_MAX];
+  float  sin[BANDS_MAX];
+} AngleTable;
+
+static void AngleTableUpdate(AngleTable* table, size_t count)
+{
+  if (table->count == count)
+    return;
+  table->count = count;
+  for (size_t i = 0; i < count; i++)
+  {
+    float angle   = i * 360.0f / count; // WRT audio freq range
+    table->cos[i] = cosf(angle * DEG2RAD);
+    table->sin[i] = sinf(angle * DEG2RAD);
+  }
+}
+
+/*******************************************************
+ *
+ * @STANDARD MODE
+ *
+ * Draws rectangles representing amplitudes as bars.
+ * The height of each rectangle corresponds to the amplitude.
+ *
+ * @PIXEL MODE
+ *
+ * Similar to STANDARD, but with a larger step to create
+ * a pixelated effect. This enhances the blocky appearance.
+ *
+ *******************************************************/
+
+typedef struct
+{
+  float step; // bar width as a fraction of the cell [0.01 - 0.06 looks good ig]
+  Color color;
+  int   width, height;
+  float cell_width;
+} BarsState;
+
+static void StandardInit(void* state)
+{
+  *(BarsState*)state = (BarsState){.step = 0.4f, .color = GRUVBOX_RED};
+}
+
+static void PixelInit(void* state)
+{
+  *(BarsState*)state = (BarsState){.step = 1.06f, .color = GRUVBOX_PURPLE};
+}
+
+static void BarsResize(void* state, int width, int height)
+{
+  BarsState* bars = state;
+  bars->width     = width;
+  bars->height    = height;
+}
+
+static void BarsUpdate(void* state, const ModeFrame* frame)
+{
+  BarsState* bars  = state;
+  bars->cell_width = frame->count > 0 ? (float)bars->width / frame->count : 0.0f;
+}
+
+static void BarsDraw(const void* state, const ModeFrame* frame, FrameGeometry* geom)
+{
+  const BarsState* bars = state;
+  const float*     amp  = frame->amplitudes;
+  for (size_t i = 0; i + 1 < frame->count; i++)
+  {
+    if (amp[i] > 0.01f)
+      GeomCoolRectangle(geom, i * bars->cell_width, bars->height - bars->height * amp[i],
+                        bars->cell_width * bars->step, bars->height * amp[i], bars->color);
+  }
+}
+
+/*******************************************************
+ *
+ * @WAVEFORM MODE
+ *
+ * Visualizes the amplitudes as a line waveform.
+ * Connects the amplitude points with lines for smooth transitions.
+ *
+ *******************************************************/
+
+typedef struct
+{
+  int   width, height;
+  float cell_width;
+} WaveformState;
+
+static void WaveformInit(void* state) { memset(state, 0, sizeof(WaveformState)); }
+
+static void WaveformResize(void* state, int width, int height)
+{
+  WaveformState* wave = state;
+  wave->width         = width;
+  wave->height        = height;
+}
+
+static void WaveformUpdate(void* state, const ModeFrame* frame)
+{
+  WaveformState* wave = state;
+  wave->cell_width    = frame->count > 0 ? (float)wave->width / frame->count : 0.0f;
+}
+
+static void WaveformDraw(const void* state, const ModeFrame* frame, FrameGeometry* geom)
+{
+  const WaveformState* wave   = state;
+  const float*         amp    = frame->amplitudes;
+  float                center = wave->height / 2;
+  for (size_t i = 0; i + 1 < frame->count; i++)
+  {
+    if (amp[i] <= 0.01f)
+      continue;
+    Vector2 start = {i * wave->cell_width, center + (wave->height / 2) * amp[i]};
+    Vector2 end   = {(i + 1) * wave->cell_width, center + (wave->height / 2) * amp[i + 1]};
+    GeomLineEx(geom, start, end, 2.0f, GRUVBOX_BLUE);
+  }
+}
+
+/*******************************************************
+ *
+ * @STARBURST MODE
+ *
+ * Draws radial lines (rays) emanating from the center.
+ * Each ray's length is determined by the amplitude, and
+ * color varies based on the index.
+ *
+ *******************************************************/
+
+typedef struct
+{
+  Vector2    center;
+  float      length; // ray length at full amplitude
+  AngleTable angles;
+} StarburstState;
+
+static void StarburstInit(void* state) { memset(state, 0, sizeof(StarburstState)); }
+
+static void StarburstResize(void* state, int width, int height)
+{
+  StarburstState* star = state;
+  star->center         = (Vector2){width / 2, height / 2};
+  star->length         = height / 2;
+}
+
+static void StarburstUpdate(void* state, const ModeFrame* frame)
+{
+  AngleTableUpdate(&((StarburstState*)state)->angles, frame->count);
+}
+
+static void StarburstDraw(const void* state, const ModeFrame* frame, FrameGeometry* geom)
+{
+  const StarburstState* star = state;
+  const float*          amp  = frame->amplitudes;
+
+  const Color colors[6] = {GRUVBOX_YELLOW, GRUVBOX_BLUE,   GRUVBOX_GREEN,
+                           GRUVBOX_RED,    GRUVBOX_ORANGE, GRUVBOX_PURPLE};
+  for (size_t i = 0; i + 1 < frame->count; i++)
+  {
+    if (amp[i] <= 0.01f)
+      continue;
+    Vector2 end = {star->center.x + star->angles.cos[i] * amp[i] * star->length,
+                   star->center.y + star->angles.sin[i] * amp[i] * star->length};
+    GeomLineEx(geom, star->center, end, 2.0f, colors[i % 6]); // Draw the ray
+  }
+}
+
+/*******************************************************
+ *
+ * @RADIAL BARS MODE
+ *
+ * Draws bars radiating from the center, similar to STARBURST,
+ * but using circular sections. The length of each bar is
+ * based on the amplitude, and bars have a color scheme.
+ *
+ *******************************************************/
+
+typedef struct
+{
+  Vector2    center;
+  int        width, height;
+  float      thickness;
+  AngleTable angles;
+  float      smoothed[BANDS_MAX]; // average of previous and current amplitudes
+} RadialBarsState;
+
+static void RadialBarsInit(void* state) { memset(state, 0, sizeof(RadialBarsState)); }
+
+static void RadialBarsResize(void* state, int width, int height)
+{
+  RadialBarsState* radial = state;
+  radial->center          = (Vector2){width / 2, height / 2};
+  radial->width           = width;
+  radial->height          = height;
+}
+
+static void RadialBarsUpdate(void* state, const ModeFrame* frame)
+{
+  RadialBarsState* radial = state;
+  AngleTableUpdate(&radial->angles, frame->count);
+  radial->thickness = frame->count > 0 ? (float)radial->width / frame->count * 0.4f : 0.0f;
+
+  // Use a smoothed amplitude value [the average of prev and current amps at TARGET_FPS, with
+  // the same time constant at any other frame rate]
+  float keep = frame->smoothing ? powf(0.5f, frame->frameTime * TARGET_FPS) : 0.0f;
+  for (size_t i = 0; i < frame->count; i++)
+  {
+    radial->smoothed[i] = keep * radial->smoothed[i] + (1.0f - keep) * frame->amplitudes[i];
+  }
+}
+
+static void RadialBarsDraw(const void* state, const ModeFrame* frame, FrameGeometry* geom)
+{
+  const RadialBarsState* radial = state;
+  float innerRadius    = radial->height / 8 * (1.0f + 0.3f * frame->beatPulse); // Pulses on beats
+  float outerRadius    = radial->height / 4; // Base radius for bars
+  float amplitudeScale = radial->height / 4; // Scaling factor for amplitude
+  bool  hub            = false;
+
+  const Color colors[6] = {GRUVBOX_YELLOW, GRUVBOX_BLUE, GRUVBOX_GREEN,
+                           GRUVBOX_ORANGE, GRUVBOX_AQUA, GRUVBOX_PURPLE};
+
+  for (size_t i = 0; i + 1 < frame->count; i++)
+  {
+    if (frame->amplitudes[i] <= 0.01f)
+      continue;
+
+    // Draw the inner circle (once, it is the same for every bar)
+    if (!hub)
+    {
+      GeomCircle(geom, radial->center, innerRadius, GRUVBOX_FG);
+      GeomCircleLines(geom, radial->center, innerRadius, GRUVBOX_FG);
+      hub = true;
+    }
+
+    float   c     = radial->angles.cos[i];
+    float   s     = radial->angles.sin[i];
+    float   reach = outerRadius + radial->smoothed[i] * amplitudeScale;
+    Vector2 start = {radial->center.x + c * outerRadius, radial->center.y + s * outerRadius};
+    Vector2 end   = {radial->center.x + c * reach, radial->center.y + s * reach};
+    GeomLineEx(geom, start, end, radial->thickness, colors[i % 6]); // Draw the radial bar
+  }
+}
+
+BarsState       standardState, pixelState;
+WaveformState   waveformState;
+StarburstState  starburstState;
+RadialBarsState radialBarsState;
+
+const VisualizationModeOps visualizationModes[NUM_MODES] = {
+  [STANDARD]    = {&standardState, StandardInit, BarsResize, BarsUpdate, BarsDraw},
+  [PIXEL]       = {&pixelState, PixelInit, BarsResize, BarsUpdate, BarsDraw},
+  [WAVEFORM]    = {&waveformState, WaveformInit, WaveformResize, WaveformUpdate, WaveformDraw},
+  [STARBURST]   = {&starburstState, StarburstInit, StarburstResize, StarburstUpdate,
+                   StarburstDraw},
+  [RADIAL_BARS] = {&radialBarsState, RadialBarsInit, RadialBarsResize, RadialBarsUpdate,
+                   RadialBarsDraw},
+};
+
+/* Builds one frame of the current mode into geom, see @FRAME GEOMETRY */
+void handleVisualization(FrameGeometry* geom, const GeometryInput* input)
+{
+  static int current = -1;
+  static int width = -1, height = -1;
+
+  const VisualizationModeOps* mode = &visualizationModes[input->mode];
+  if ((int)input->mode != current || input->width != width || input->height != height)
+  {
+    if ((int)input->mode != current)
+      mode->init(mode->state); // smoothing starts from this frame, not from stale values
+    current = input->mode;
+    width   = input->width;
+    height  = input->height;
+    mode->resize(mode->state, width, height);
+  }
+
+  geom->vert_count  = 0;
+  geom->batch_count = 0;
+  geom->decorations = input->decorations;
+
+  // Calculate amplitude for all bands once
+  ModeFrame frame;
+  float     maxAmplitude = input->frame.peak > 0 ? input->frame.peak : 1;
+  frame.count            = input->frame.band_count;
+  frame.beatPulse        = input->beatPulse;
+  frame.smoothing        = input->smoothing;
+  frame.frameTime        = input->frameTime;
+  for (size_t i = 0; i < frame.count; i++)
+  {
+    frame.amplitudes[i] = input->frame.bands[i] / maxAmplitude; // Normalize amplitude
+  }
+
+  mode->update(mode->state, &frame);
+  mode->draw(mode->state, &frame, geom);
+}
+
+/*************************************************************
+ *
+ * @GEOMETRY PIPELINE
+ *
+ * A worker thread runs handleVisualization() for frame N + 1
+ * into one FrameGeometry while the main thread submits frame
+ * N from the other:
+ *
+ *   main   | acquire N | request N+1 | submit N, UI ... | acquire N+1 |
+ *   worker |           | build N+1 .................... |
+ *
+ * The price is one frame of visual latency. GeometryAcquire()
+ * only waits if the worker is slower than a whole main loop
+ * iteration. With a single CPU the build simply runs inline
+ * in GeometryRequest(), with the same one-frame offset.
+ *
+ ************************************************************/
+
+typedef struct
+{
+  FrameGeometry   buffers[2];
+  int             front;    // the one the main thread submits
+  GeometryInput   input;    // for the next build
+  bool            building; // worker owns buffers[!front]
+  bool            ready;    // buffers[!front] is complete and newer than buffers[front]
+  bool            quit;
+  bool            threaded;
+  pthread_t       worker;
+  pthread_mutex_t lock;
+  pthread_cond_t  cond;
+} GeometryPipeline;
+
+GeometryPipeline geometryPipeline = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                                     .cond = PTHREAD_COND_INITIALIZER};
+
+void* GeometryWorker(void* arg)
+{
+  GeometryPipeline* gp = arg;
+  pthread_mutex_lock(&gp->lock);
+  for (;;)
+  {
+    while (!gp->quit && !gp->building)
+      pthread_cond_wait(&gp->cond, &gp->lock);
+    if (gp->quit)
+      break;
+
+    GeometryInput  input = gp->input;
+    FrameGeometry* back  = &gp->buffers[!gp->front];
+    pthread_mutex_unlock(&gp->lock);
+
+    handleVisualization(back, &input);
+
+    pthread_mutex_lock(&gp->lock);
+    gp->building = false;
+    gp->ready    = true;
+    pthread_cond_broadcast(&gp->cond);
+  }
+  pthread_mutex_unlock(&gp->lock);
+  return NULL;
+}
+
+void GeometryPipelineStart(GeometryPipeline* gp)
+{
+  gp->threaded = sysconf(_SC_NPROCESSORS_ONLN) > 1 &&
+                 pthread_create(&gp->worker, NULL, GeometryWorker, gp) == 0;
+}
+
+void GeometryPipelineStop(GeometryPipeline* gp)
+{
+  if (!gp->threaded)
+    return;
+  pthread_mutex_lock(&gp->lock);
+  gp->quit = true;
+  pthread_cond_broadcast(&gp->cond);
+  pthread_mutex_unlock(&gp->lock);
+  pthread_join(gp->worker, NULL);
+  gp->threaded = false;
+}
+
+/* Hands the next frame's input to the builder; never waits for the build itself */
+void GeometryRequest(GeometryPipeline* gp, const GeometryInput* input)
+{
+  pthread_mutex_lock(&gp->lock);
+  while (gp->building)
+    pthread_cond_wait(&gp->cond, &gp->lock);
+  gp->input = *input;
+  if (gp->threaded)
+  {
+    gp->building = true;
+    pthread_cond_broadcast(&gp->cond);
+    pthread_mutex_unlock(&gp->lock);
+    return;
+  }
+  pthread_mutex_unlock(&gp->lock);
+  handleVisualization(&gp->buffers[!gp->front], &gp->input);
+  gp->ready = true;
+}
+
+/* Newest complete geometry; waits only if a requested build is still running */
+const FrameGeometry* GeometryAcquire(GeometryPipeline* gp)
+{
+  pthread_mutex_lock(&gp->lock);
+  while (gp->building)
+    pthread_cond_wait(&gp->cond, &gp->lock);
+  if (gp->ready)
+  {
+    gp->front = !gp->front;
+    gp->ready = false;
+  }
+  pthread_mutex_unlock(&gp->lock);
+  return &gp->buffers[gp->front];
+}
+
+void DrawHelpBox(bool showHelp, Font font, const int screenHeight, const int screenWidth)
+{
+  if (showHelp)
+  {
+    int boxWidth  = screenWidth / 2;
+    int boxHeight = screenHeight / 2 + 7; // some padding
+    int boxX      = (GetScreenWidth() - boxWidth) / 2;
+    int boxY      = (GetScreenHeight() - boxHeight) / 2;
+
+    // Draw the outer glowing rectangle using Gruvbox red for the border
+    DrawRectangle(boxX - 10, boxY - 10, boxWidth + 20, boxHeight + 20, GRUVBOX_RED);
+    DrawRectangle(boxX, boxY, boxWidth, boxHeight,
+                  ColorAlpha(GRUVBOX_BG, 0.95f)); // Gruvbox background
+
+    // Title with Gruvbox yellow
+    DrawTextEx(font, "Help for rAVen:", (Vector2){boxX + 20, boxY + 20}, 30, 2, GRUVBOX_YELLOW);
+
+    // Display help commands in Gruvbox foreground
+    char helpText[1024];
+    snprintf(helpText, sizeof(helpText), "Commands:\n");
+    for (int i = 0; i < ARRAY_LEN(helpCommands); i++)
+    {
+      snprintf(helpText + strlen(helpText), sizeof(helpText) - strlen(helpText), "%s\n",
+               helpCommands[i]);
+    }
+    DrawTextEx(font, helpText, (Vector2){boxX + 20, boxY + 60}, 20, 1, GRUVBOX_FG);
+  }
+}
+
+void LimitText(char* dest, const char* src, int maxLength)
+{
+  if (strlen(src) > maxLength)
+  {
+    strncpy(dest, src, maxLength - 3); // Copy up to maxLength - 3 characters
+    dest[maxLength - 3] = '\0';        // Ensure null termination
+    strcat(dest, "...");               // Append "..." to indicate truncation
+  }
+  else
+  {
+    strcpy(dest, src); // Copy the full string if it fits within the limit
+  }
+}
+
+void DrawSpaceTheme(Font font, AudioStream stream, MusicMetadata* metadata)
+{
+  // Constants
+  int boxWidth  = 400; // Width of the text box
+  int padding   = 40;  // Padding for the text inside the box
+  int charLimit = 30;  // Maximum character limit for each line (adjust as needed)
+
+  // Draw the outer glowing rectangle for space-themed effect
+  DrawRectangle(15, 95, 410, 210, GRUVBOX_BLUE); // Outer glow effect
+  DrawRectangle(20, 100, boxWidth, 200,
+                ColorAlpha(GRUVBOX_BG, 0.85f)); // Main box with Gruvbox background
+
+  // Draw the title with a Gruvbox-style glowing effect
+  DrawTextEx(font, "Track Info", (Vector2){padding, 110}, 24, 2,
+             GRUVBOX_YELLOW); // Gruvbox yellow for title
+
+  // Create and display the text with metadata
+  char title[128], artist[128], album[128];
+  LimitText(title, metadata->title[0] ? metadata->title : "Unknown", charLimit);
+  LimitText(artist, metadata->artist[0] ? metadata->artist : "Unknown", charLimit);
+  LimitText(album, metadata->album[0] ? metadata->album : "Unknown", charLimit);
+
+  char infoText[512];
+  snprintf(infoText, sizeof(infoText),
+           "Title: %s\nArtist: %s\nAlbum: %s\nSample Rate: %d Hz\nChannels: %d\nSample Size: "
+           "%d-bit\nDuration: %.2f sec",
+           title, artist, album, stream.sampleRate, stream.channels, stream.sampleSize,
+           metadata->duration);
+
+  // Display the metadata text with Gruvbox foreground color
+  DrawTextEx(font, infoText, (Vector2){padding, 150}, 20, 1, GRUVBOX_FG);
+
+  // Add additional space elements (stars, nebula effect, etc.)
+  for (int i = 0; i < 50; i++)
+  {
+    DrawCircle(rand() % 450 + 20, rand() % 220 + 100, 1,
+               ColorAlpha(GRUVBOX_FG, 0.5f)); // Stars using Gruvbox foreground color
+  }
+
+  // Add a glowing nebula at the bottom-right corner using Gruvbox colors
+  DrawCircleGradient(380, 280, 50, ColorAlpha(GRUVBOX_AQUA, 0.2f),
+                     ColorAlpha(GRUVBOX_PURPLE, 0.0f)); // Nebula glow using Gruvbox aqua and purple
+}
+
+/*************************************************************
+ *
+ * @RETAINED UI
+ *
+ * Title, HUD, time bar, buttons, help box and track info only
+ * change when their inputs do (metadata, volume, play state,
+ * the seconds counter ...), yet used to be measured, formatted
+ * and drawn from scratch every frame.
+ *
+ * Each of them now lives in a UiPanel: a RenderTexture plus
+ * the key (a small POD struct of its inputs) it was rendered
+ * with. UiPanelBegin() returns false while the key is
+ * unchanged, otherwise it opens the texture with a camera
+ * offset so the existing absolute-position draw code can be
+ * reused as is. Compositing is one textured quad per panel.
+ *
+ * $BLENDING
+ *
+ * Panels are rendered with premultiplied alpha (color blended
+ * as usual, alpha accumulated with ONE / ONE_MINUS_SRC_ALPHA)
+ * and composited with BLEND_ALPHA_PREMULTIPLY, so translucent
+ * boxes and anti-aliased text look the same as when drawn
+ * straight to the screen.
+ *
+ ************************************************************/
+
+typedef struct
+{
+  RenderTexture2D target;
+  Rectangle       bounds; // where the panel is composited on screen
+  unsigned char   key[UI_KEY_MAX];
+  size_t          key_len;
+  bool            valid;
+} UiPanel;
+
+bool UiPanelBegin(UiPanel* panel, Rectangle bounds, const void* key, size_t key_len)
+{
+  assert(key_len <= UI_KEY_MAX);
+  bool same_size = panel->valid && panel->bounds.width == bounds.width &&
+                   panel->bounds.height == bounds.height;
+  if (same_size && panel->bounds.x == bounds.x && panel->bounds.y == bounds.y &&
+      panel->key_len == key_len && memcmp(panel->key, key, key_len) == 0)
+  {
+    return false;
+  }
+
+  if (!same_size)
+  {
+    if (panel->target.id != 0)
+      UnloadRenderTexture(panel->target);
+    panel->target = LoadRenderTexture(bounds.width, bounds.height);
+  }
+  panel->bounds  = bounds;
+  panel->key_len = key_len;
+  memcpy(panel->key, key, key_len);
+
+  BeginTextureMode(panel->target);
+  ClearBackground(BLANK);
+  rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA,
+                            RL_FUNC_ADD, RL_FUNC_ADD);
+  BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+  BeginMode2D((Camera2D){.offset = {-bounds.x, -bounds.y}, .zoom = 1.0f});
+  return true;
+}
+
+void UiPanelEnd(UiPanel* panel)
+{
+  EndMode2D();
+  EndBlendMode();
+  EndTextureMode();
+  panel->valid = true;
+}
+
+void UiPanelDraw(const UiPanel* panel, float alpha)
+{
+  if (!panel->valid)
+    return;
+  unsigned char a = (unsigned char)(255 * alpha); // premultiplied tint
+  BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+  DrawTextureRec(panel->target.texture,
+                 (Rectangle){0, 0, panel->bounds.width, -panel->bounds.height},
+                 (Vector2){panel->bounds.x, panel->bounds.y}, (Color){a, a, a, a});
+  EndBlendMode();
+}
+
+void UiPanelUnload(UiPanel* panel)
+{
+  if (panel->target.id != 0)
+    UnloadRenderTexture(panel->target);
+  memset(panel, 0, sizeof(*panel));
+}
+
+/* Panel keys are compared with memcmp: plain ints, or memset before filling in */
+typedef struct
+{
+  int playing, volume, muted, engine, decimation, quality, governor;
+  int live, overruns, underruns;
+  int latency_ms, offset_ms;
+} HudKey;
+
+typedef struct
+{
+  int played, total;
+} TimeKey;
+
+typedef struct
+{
+  int showInfo, showHelp;
+} ButtonKey;
+
+typedef struct
+{
+  MusicMetadata metadata;
+  int           sampleRate, channels, sampleSize;
+} TrackKey;
+
+/* Meter readings in tenths of a dB, so the panel only redraws when a shown digit changes */
+typedef struct
+{
+  int momentary, short_term, integrated, rms, true_peak, true_peak_max;
+} MeterKey;
+
+static int MeterTenths(float db) { return isfinite(db) ? (int)lroundf(db * 10.0f) : INT16_MIN; }
+
+/* One labelled meter line with a bar over [METER_FLOOR_DB, 0] */
+void DrawMeterLine(Font font, float x, float y, const char* label, int tenths, const char* unit,
+                   Color color)
+{
+  char text[48];
+  if (tenths == INT16_MIN)
+    snprintf(text, sizeof(text), "%-4s  -inf %s", label, unit);
+  else
+    snprintf(text, sizeof(text), "%-4s %5.1f %s", label, tenths / 10.0f, unit);
+  DrawTextEx(font, text, (Vector2){x, y}, 20, 1, color);
+
+  float level = tenths == INT16_MIN ? 0.0f : 1.0f - (tenths / 10.0f) / METER_FLOOR_DB;
+  level       = level < 0.0f ? 0.0f : level > 1.0f ? 1.0f : level;
+  DrawRectangle(x, y + 20, 220, 4, ColorAlpha(GRUVBOX_FG, 0.15f));
+  DrawRectangle(x, y + 20, 220 * level, 4, color);
+}
+
+void extract_metadata(const char* filename, MusicMetadata* metadata)
+{
+  AVFormatContext* fmt_ctx = NULL;
+
+  // Open the audio file and read its header
+  if (avformat_open_input(&fmt_ctx, filename, NULL, NULL) < 0)
+  {
+    printf("Could not open file: %s\n", filename);
+    return;
+  }
+
+  // Retrieve stream information
+  if (avformat_find_stream_info(fmt_ctx, NULL) < 0)
+  {
+    printf("Could not find stream information\n");
+    avformat_close_input(&fmt_ctx);
+    return;
+  }
+
+  AVDictionaryEntry* tag = NULL;
+
+  // Extract metadata (title, artist, album)
+  if ((tag = av_dict_get(fmt_ctx->metadata, "title", NULL, 0)))
+  {
+    strncpy(metadata->title, tag->value, sizeof(metadata->title) - 1);
+    metadata->title[sizeof(metadata->title) - 1] = '\0';
+  }
+  else
+  {
+    strncpy(metadata->title, "Unknown Title", sizeof(metadata->title) - 1);
+    metadata->title[sizeof(metadata->title) - 1] = '\0';
+  }
+
+  if ((tag = av_dict_get(fmt_ctx->metadata, "artist", NULL, 0)))
+  {
+    strncpy(metadata->artist, tag->value, sizeof(metadata->artist) - 1);
+    metadata->artist[sizeof(metadata->artist) - 1] = '\0';
+  }
+  else
+  {
+    strncpy(metadata->artist, "Unknown Artist", sizeof(metadata->artist) - 1);
+    metadata->artist[sizeof(metadata->artist) - 1] = '\0';
+  }
+
+  if ((tag = av_dict_get(fmt_ctx->metadata, "album", NULL, 0)))
+  {
+    strncpy(metadata->album, tag->value, sizeof(metadata->album) - 1);
+    metadata->album[sizeof(metadata->album) - 1] = '\0';
+  }
+  else
+  {
+    strncpy(metadata->album, "Unknown Album", sizeof(metadata->album) - 1);
+    metadata->album[sizeof(metadata->album) - 1] = '\0';
+  }
+
+  // Extract duration in seconds
+  metadata->duration = fmt_ctx->duration / (float)AV_TIME_BASE;
+
+  // Close the input context
+  avformat_close_input(&fmt_ctx);
+}
+
+/*************************************************************
+ *
+ * @MAPPED AUDIO
+ *
+ * Uncompressed WAV (including RF64 for files over 4 GiB) and
+ * raw PCM files need no decoder: the file is mmap()ed, the
+ * header is checked once, and from then on the samples are
+ * read straight out of the page cache.
+ *
+ * -> Playback uses a raylib stream callback
+ *    (MappedStreamCallback()) on the audio thread, which
+ *    writes the mixer's buffer directly from the mapping.
+ *    There is no decoder, no UpdateAudioStream() and no
+ *    intermediate stream buffer.
+ * -> Analysis gets a pointer into the mapping for float
+ *    stereo files, so callback() reads the file's own pages.
+ *    Other formats are converted once, into the mixer's
+ *    buffer, and analyzed from there.
+ * -> The whole mapping is MADV_SEQUENTIAL. The main thread
+ *    keeps MAP_AHEAD_SECONDS ahead of the play cursor
+ *    MADV_WILLNEED (readahead starts, nothing blocks), and a
+ *    seek prefills its target before the cursor moves there,
+ *    so the audio thread does not fault on a cold page.
+ *
+ * --replay loads its sample file the same way.
+ *
+ ************************************************************/
+
+size_t PcmSampleBytes(PcmFormat format)
+{
+  return format == PCM_S16LE ? 2 : format == PCM_S24LE ? 3 : 4;
+}
+
+float PcmSample(const unsigned char* p, PcmFormat format)
+{
+  switch (format)
+  {
+    case PCM_S16LE:
+      return (int16_t)(p[0] | p[1] << 8) / 32768.0f;
+    case PCM_S24LE:
+      return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) /
+             2147483648.0f;
+    case PCM_S32LE:
+      return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+                       (uint32_t)p[3] << 24) /
+             2147483648.0f;
+    case PCM_F32LE:
+    default:
+    {
+      uint32_t u = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+                   (uint32_t)p[3] << 24;
+      float f;
+      memcpy(&f, &u, sizeof(f));
+      return f;
+    }
+  }
+}
+
+/* Interleaved frames of any channel count to float stereo (first two channels, mono doubled) */
+void PcmConvertFrames(const unsigned char* src, PcmFormat format, unsigned channels,
+                      float (*dst)[2], size_t frames)
+{
+  size_t sample_bytes = PcmSampleBytes(format);
+  size_t frame_bytes  = sample_bytes * channels;
+  for (size_t i = 0; i < frames; i++, src += frame_bytes)
+  {
+    dst[i][0] = PcmSample(src, format);
+    dst[i][1] = channels > 1 ? PcmSample(src + sample_bytes, format) : dst[i][0];
+  }
+}
+
+#define MAPPED_NO_SEEK UINT64_MAX
+
+typedef struct
+{
+  int                  fd;
+  unsigned char*       map;
+  size_t               map_size;
+  const unsigned char* data; // first sample frame
+  uint64_t             frames;
+  unsigned             rate;
+  unsigned             channels;
+  PcmFormat            format;
+  size_t               frame_bytes;
+  bool                 direct; // float stereo, analysis reads the mapping itself
+
+  _Atomic uint64_t cursor;  // next frame to play, only the audio thread advances it
+  _Atomic uint64_t seek_to; // MAPPED_NO_SEEK or a frame the audio thread jumps to
+  uint64_t         ahead_from, ahead_to; // frames last madvise(MADV_WILLNEED)ed
+
+  AudioStream stream;
+} MappedAudio;
+
+MappedAudio* mapped_playing = NULL; // the one MappedStreamCallback() plays
+
+static uint16_t ReadLe16(const unsigned char* p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+static uint32_t ReadLe32(const unsigned char* p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t ReadLe64(const unsigned char* p)
+{
+  return ReadLe32(p) | (uint64_t)ReadLe32(p + 4) << 32;
+}
+
+static int MappedAudioMap(MappedAudio* m, const char* path)
+{
+  memset(m, 0, sizeof(*m));
+  m->fd = open(path, O_RDONLY);
+  if (m->fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(m->fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+  {
+    close(m->fd);
+    return -1;
+  }
+  m->map_size = st.st_size;
+  m->map      = mmap(NULL, m->map_size, PROT_READ, MAP_PRIVATE, m->fd, 0);
+  if (m->map == MAP_FAILED)
+  {
+    close(m->fd);
+    return -1;
+  }
+  madvise(m->map, m->map_size, MADV_SEQUENTIAL);
+  return 0;
+}
+
+void MappedAudioClose(MappedAudio* m)
+{
+  if (m->stream.buffer != NULL)
+    UnloadAudioStream(m->stream); // no MappedStreamCallback() runs after this returns
+  if (mapped_playing == m)
+    mapped_playing = NULL;
+  if (m->map != NULL)
+    munmap(m->map, m->map_size);
+  if (m->map != NULL && m->fd >= 0)
+    close(m->fd);
+  memset(m, 0, sizeof(*m));
+}
+
+/* Fills in the sample layout once data/frames are known; false if there is nothing to play */
+static bool MappedAudioLayout(MappedAudio* m, uint64_t data_bytes)
+{
+  m->frame_bytes = PcmSampleBytes(m->format) * m->channels;
+  if (m->channels == 0 || m->rate == 0)
+    return false;
+
+  // Files cut off while being written often claim more data than they have
+  uint64_t room = m->map_size - (size_t)(m->data - m->map);
+  if (data_bytes > room)
+    data_bytes = room;
+  m->frames = data_bytes / m->frame_bytes;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  m->direct = m->format == PCM_F32LE && m->channels == 2 &&
+              (uintptr_t)m->data % _Alignof(float) == 0;
+#endif
+  atomic_store(&m->seek_to, MAPPED_NO_SEEK);
+  return m->frames > 0;
+}
+
+/* RIFF/RF64 WAVE with integer (16/24/32-bit) or 32-bit float samples; -1 for anything else */
+int MappedAudioOpenWav(MappedAudio* m, const char* path)
+{
+  if (MappedAudioMap(m, path) != 0)
+    return -1;
+
+  const unsigned char* p    = m->map;
+  const unsigned char* end  = m->map + m->map_size;
+  bool                 rf64 = m->map_size >= 12 && memcmp(p, "RF64", 4) == 0;
+  if (m->map_size < 12 || (!rf64 && memcmp(p, "RIFF", 4) != 0) || memcmp(p + 8, "WAVE", 4) != 0)
+  {
+    MappedAudioClose(m);
+    return -1;
+  }
+
+  uint64_t data_bytes = 0, rf64_data_bytes = 0;
+  int      tag = 0, bits = 0;
+  for (p += 12; p + 8 <= end && m->data == NULL;)
+  {
+    uint64_t size = ReadLe32(p + 4);
+    const unsigned char* body = p + 8;
+    if (memcmp(p, "ds64", 4) == 0 && size >= 24 && body + 24 <= end)
+    {
+      rf64_data_bytes = ReadLe64(body + 8);
+    }
+    else if (memcmp(p, "fmt ", 4) == 0 && size >= 16 && body + 16 <= end)
+    {
+      tag          = ReadLe16(body);
+      m->channels  = ReadLe16(body + 2);
+      m->rate      = ReadLe32(body + 4);
+      bits         = ReadLe16(body + 14);
+      if (tag == 0xFFFE && size >= 40 && body + 40 <= end)
+        tag = ReadLe16(body + 24); // WAVE_FORMAT_EXTENSIBLE, sub-format GUID starts with the tag
+    }
+    else if (memcmp(p, "data", 4) == 0)
+    {
+      m->data    = body;
+      data_bytes = rf64 && size == 0xFFFFFFFFu ? rf64_data_bytes : size;
+    }
+    p = body + size + (size & 1); // chunks are padded to an even size
+  }
+
+  if (tag == 1 && (bits == 16 || bits == 24 || bits == 32))
+    m->format = bits == 16 ? PCM_S16LE : bits == 24 ? PCM_S24LE : PCM_S32LE;
+  else if (tag == 3 && bits == 32)
+    m->format = PCM_F32LE;
+  else
+    tag = 0; // compressed or exotic, left to the decoder
+
+  if (tag == 0 || m->data == NULL || !MappedAudioLayout(m, data_bytes))
+  {
+    MappedAudioClose(m);
+    return -1;
+  }
+  return 0;
+}
+
+/* Headerless interleaved PCM, layout given on the command line */
+int MappedAudioOpenRaw(MappedAudio* m, const char* path, unsigned rate, unsigned channels,
+                       PcmFormat format)
+{
+  if (MappedAudioMap(m, path) != 0)
+    return -1;
+  m->data     = m->map;
+  m->rate     = rate;
+  m->channels = channels;
+  m->format   = format;
+  if (!MappedAudioLayout(m, m->map_size))
+  {
+    MappedAudioClose(m);
+    return -1;
+  }
+  return 0;
+}
+
+/* Starts readahead for frames [from, to), page aligned */
+static void MappedAudioWillNeed(const MappedAudio* m, uint64_t from, uint64_t to)
+{
+  static size_t page = 0;
+  if (page == 0)
+    page = sysconf(_SC_PAGESIZE);
+  if (to > m->frames)
+    to = m->frames;
+  if (from >= to)
+    return;
+  size_t start = (m->data - m->map) + from * m->frame_bytes;
+  size_t stop  = (m->data - m->map) + to * m->frame_bytes;
+  start -= start % page;
+  madvise(m->map + start, stop - start, MADV_WILLNEED);
+}
+
+/* Main thread, once per loop iteration: keeps the pages ahead of the cursor on their way in */
+void MappedAudioPrefetch(MappedAudio* m)
+{
+  uint64_t ahead  = (uint64_t)m->rate * MAP_AHEAD_SECONDS;
+  uint64_t cursor = atomic_load_explicit(&m->cursor, memory_order_relaxed);
+  if (cursor >= m->ahead_from && cursor + ahead <= m->ahead_to)
+    return;
+
+  // Ask for two windows at once so this runs about once per MAP_AHEAD_SECONDS
+  m->ahead_from = cursor;
+  m->ahead_to   = cursor + 2 * ahead;
+  MappedAudioWillNeed(m, cursor, m->ahead_to);
+  if (m->ahead_to > m->frames)
+    MappedAudioWillNeed(m, 0, m->ahead_to - m->frames); // playback loops
+}
+
+void MappedAudioSeek(MappedAudio* m, double seconds)
+{
+  double   frame  = seconds * m->rate + 0.5;
+  uint64_t target = frame <= 0.0 ? 0 : frame >= m->frames ? m->frames - 1 : (uint64_t)frame;
+
+  // Prefill before the cursor gets there, then the audio thread finds the pages resident
+  m->ahead_from = target;
+  m->ahead_to   = target + 2 * (uint64_t)m->rate * MAP_AHEAD_SECONDS;
+  MappedAudioWillNeed(m, target, m->ahead_to);
+  atomic_store_explicit(&m->seek_to, target, memory_order_release);
+}
+
+/* raylib stream callback, on the audio thread; loops at the end like raylib's Music */
+void MappedStreamCallback(void* buffer, unsigned int frames)
+{
+  MappedAudio* m = mapped_playing;
+  float(*out)[2] = buffer;
+  if (m == NULL)
+  {
+    memset(out, 0, frames * sizeof(out[0]));
+    return;
+  }
+
+  uint64_t cursor = atomic_exchange_explicit(&m->seek_to, MAPPED_NO_SEEK, memory_order_acquire);
+  if (cursor == MAPPED_NO_SEEK)
+    cursor = atomic_load_explicit(&m->cursor, memory_order_relaxed);
+
+  for (unsigned int done = 0; done < frames;)
+  {
+    if (cursor >= m->frames)
+      cursor = 0;
+    uint64_t             left = m->frames - cursor;
+    size_t               n    = frames - done < left ? frames - done : left;
+    const unsigned char* src  = m->data + cursor * m->frame_bytes;
+    if (m->direct)
+    {
+      memcpy(out[done], src, n * sizeof(out[0])); // the one copy, into the mixer's buffer
+      callback((void*)src, n);
+    }
+    else
+    {
+      PcmConvertFrames(src, m->format, m->channels, out + done, n);
+      callback(out[done], n);
+    }
+    done += n;
+    cursor += n;
+  }
+  atomic_store_explicit(&m->cursor, cursor, memory_order_release);
+}
+
+/* Creates the playback stream; only one mapped source plays at a time */
+void MappedAudioPlay(MappedAudio* m)
+{
+  m->stream = LoadAudioStream(m->rate, 32, 2);
+  RestartAnalysis(m->rate);
+  mapped_playing = m;
+  SetAudioStreamCallback(m->stream, MappedStreamCallback);
+  PlayAudioStream(m->stream);
+}
+
+/*************************************************************
+ *
+ * @BENCHMARK
+ *
+ * Feeds one second of a fixed synthetic signal (a few tones
+ * plus LCG noise) through callback() over and over for every
+ * analysis configuration, without a window or audio device,
+ * and reports the cost per sample and per block.
+ *
+ ************************************************************/
+
+int run_benchmark(void)
+{
+  enum
+  {
+    RATE    = 44100,
+    BLOCK   = 441, // 10 ms, close to what the mixer hands us
+    SECONDS = 20
+  };
+  static float signal[RATE][2];
+
+  uint32_t seed = 0x12345678u;
+  for (size_t i = 0; i < RATE; i++)
+  {
+    float t = (float)i / RATE;
+    seed    = seed * 1664525u + 1013904223u;
+    float v = 0.4f * sinf(2 * pi * 55.0f * t) + 0.2f * sinf(2 * pi * 440.0f * t) +
+              0.1f * sinf(2 * pi * 3520.0f * t) + 0.05f * ((seed >> 8) / 8388608.0f - 1.0f);
+    signal[i][0] = v;
+    signal[i][1] = v;
+  }
+
+  struct
+  {
+    const char* name;
+    int         engine;
+    int         decimation;
+  } cases[] = {
+    {"fft", ENGINE_FFT, 1},
+    {"fft + 8x bass", ENGINE_FFT, 8},
+    {"resonator bank", ENGINE_RESONATOR, 1},
+  };
+
+  atomic_store(&analysis_sample_rate, RATE);
+  printf("[rAVen] analysis benchmark: %d s of audio, %d-frame blocks, N = %d\n", SECONDS, BLOCK,
+         N);
+  for (size_t c = 0; c < ARRAY_LEN(cases); c++)
+  {
+    atomic_store(&requested_engine, cases[c].engine);
+    atomic_store(&requested_decimation, cases[c].decimation);
+    for (size_t i = 0; i < RATE; i += BLOCK) // warm up, lets callback() rebuild its state
+      callback(signal[i], BLOCK);
+
+    double start = now_seconds();
+    for (int sec = 0; sec < SECONDS; sec++)
+    {
+      for (size_t i = 0; i < RATE; i += BLOCK)
+        callback(signal[i], BLOCK);
+    }
+    double elapsed = now_seconds() - start;
+    double samples = (double)SECONDS * RATE;
+    printf("  %-16s %8.1f ns/sample %9.1f us/block %8.0fx realtime\n", cases[c].name,
+           elapsed * 1e9 / samples, elapsed * 1e6 / (samples / BLOCK), SECONDS / elapsed);
+  }
+  return 0;
+}
+
+/*************************************************************
+ *
+ * @REPLAY
+ *
+ * Deterministic regression harness for the analysis path.
+ * Fixed signals go through callback() in REPLAY_BLOCK-frame
+ * blocks, from a clean state (see analysis_epoch), once per
+ * engine configuration, and every published frame is kept:
+ *
+ *   raven --replay[=dir] --record   writes <dir>/<case>.golden
+ *                                   and <dir>/baseline.txt
+ *   raven --replay[=dir]            checks against them
+ *
+ * The default dir is tests/replay, whose goldens are part of
+ * the repository (make check). Its baseline.txt is not: it is
+ * written per machine with --record=baseline, which checks the
+ * spectra as usual and only replaces the timings.
+ *
+ * $GOLDEN SPECTRA
+ *
+ * A case passes if it produces the same number of frames and
+ * bands and no band differs from the golden one by more than
+ * REPLAY_TOLERANCE of the largest golden band of that case.
+ * Each block also records how many frames the run had
+ * published by then, which must match exactly: blocks before
+ * the first publish (the DecimAlign() hold-back) are stored
+ * as empty, never as a frame left over from an earlier run.
+ * Beat counts are reported but not gated: a last-bit change
+ * may legitimately move a marginal onset by one hop.
+ *
+ * $THROUGHPUT
+ *
+ * Each case is then timed (best of REPLAY_RUNS, in thread CPU
+ * time so preemption does not count) and compared with the
+ * recorded baseline. Single cases swing by tens of percent
+ * between identical runs, so they are only reported; the run
+ * fails if the median case is more than --perf-slack percent
+ * slower per sample. Baselines only mean something on the
+ * machine they were recorded on; without one, or with
+ * --perf-slack=off (make check), speed is only reported.
+ *
+ * The exit status is 0 only if every case passes.
+ *
+ ************************************************************/
+
+#define REPLAY_GOLDEN_MAGIC "RVNGOLD2"
+
+// One published frame per block, so golden frame b is the spectrum after block b
+_Static_assert(REPLAY_BLOCK == ANALYSIS_HOP, "replay blocks must be exactly one analysis hop");
+
+typedef struct
+{
+  const char* name;
+  float (*pcm)[2];
+  size_t   frames;
+  unsigned rate;
+} ReplaySignal;
+
+typedef struct
+{
+  size_t    frames;     // analysis frames (callback() blocks)
+  size_t    band_count;
+  float*    bands;      // frames * BANDS_MAX, band_count used per frame
+  uint32_t* beat_count; // per frame
+  uint32_t* published;  // per frame: frames this run has published so far, 0 = none yet
+} ReplayTrace;
+
+typedef struct
+{
+  char     magic[8];
+  uint32_t block;
+  uint32_t rate;
+  uint32_t frames;
+  uint32_t band_count;
+} ReplayGoldenHeader;
+
+/* 5 s of tones plus LCG noise, a 20 Hz - 20 kHz log sweep or 8 s of 120 BPM kicks over a pad */
+static bool ReplaySynth(ReplaySignal* sig, const char* name)
+{
+  enum
+  {
+    RATE = 44100
+  };
+  float seconds = strcmp(name, "kicks") == 0 ? 8.0f : 5.0f;
+
+  sig->name   = name;
+  sig->rate   = RATE;
+  sig->frames = (size_t)(seconds * RATE);
+  sig->pcm    = malloc(sig->frames * sizeof(sig->pcm[0]));
+  if (sig->pcm == NULL)
+    return false;
+
+  uint32_t seed  = 0x12345678u;
+  double   phase = 0.0;
+  for (size_t i = 0; i < sig->frames; i++)
+  {
+    float t = (float)i / RATE;
+    seed    = seed * 1664525u + 1013904223u;
+    float noise = (seed >> 8) / 8388608.0f - 1.0f;
+    float v     = 0.0f;
+    if (strcmp(name, "tones") == 0)
+    {
+      v = 0.4f * sinf(2 * pi * 55.0f * t) + 0.2f * sinf(2 * pi * 440.0f * t) +
+          0.1f * sinf(2 * pi * 3520.0f * t) + 0.05f * noise;
+    }
+    else if (strcmp(name, "sweep") == 0)
+    {
+      phase += 2 * M_PI * 20.0 * pow(1000.0, t / seconds) / RATE;
+      v = 0.5f * (float)sin(phase);
+    }
+    else
+    {
+      float beat = fmodf(t, 0.5f); // 120 BPM
+      v = 0.8f * expf(-beat * 30.0f) * sinf(2 * pi * 60.0f * beat) +
+          0.1f * sinf(2 * pi * 220.0f * t) + 0.02f * noise;
+    }
+    sig->pcm[i][0] = v;
+    sig->pcm[i][1] = v;
+  }
+  return true;
+}
+
+/* Float stereo files are used in place, anything else is converted once; no decoder either way */
+static bool ReplayLoadWave(ReplaySignal* sig, MappedAudio* wav, const char* path)
+{
+  if (MappedAudioOpenWav(wav, path) != 0)
+    return false;
+
+  sig->name   = "sample-15s";
+  sig->rate   = wav->rate;
+  sig->frames = wav->frames;
+  if (wav->direct)
+  {
+    sig->pcm = (float(*)[2])wav->data;
+    return true;
+  }
+  sig->pcm = malloc(sig->frames * sizeof(sig->pcm[0]));
+  if (sig->pcm != NULL)
+    PcmConvertFrames(wav->data, wav->format, wav->channels, sig->pcm, sig->frames);
+  return sig->pcm != NULL;
+}
+
+static double ReplayCpuSeconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Pushes the whole signal through callback() from a clean state; trace may be NULL (timing) */
+static void ReplayRun(const ReplaySignal* sig, int engine, int decimation, ReplayTrace* trace)
+{
+  atomic_store(&requested_engine, engine);
+  atomic_store(&requested_decimation, decimation);
+  atomic_store(&quality_level, 0);
+  RestartAnalysis(sig->rate);
+  // The ring keeps the previous run's frames, only those after this point are ours
+  uint64_t first = atomic_load(&analysis_head);
+
+  size_t blocks = sig->frames / REPLAY_BLOCK;
+  if (trace != NULL)
+    trace->band_count = 0;
+  for (size_t b = 0; b < blocks; b++)
+  {
+    callback(sig->pcm[b * REPLAY_BLOCK], REPLAY_BLOCK);
+    if (trace == NULL)
+      continue;
+
+    // Hops before the first publish (e.g. the DecimAlign() hold-back) are recorded as empty
+    AnalysisFrame frame;
+    float*        bands = &trace->bands[b * BANDS_MAX];
+    if (!AnalysisReadLatest(&frame) || frame.seq <= first)
+    {
+      memset(bands, 0, BANDS_MAX * sizeof(float));
+      trace->beat_count[b] = 0;
+      trace->published[b]  = 0;
+      continue;
+    }
+    trace->band_count = frame.band_count;
+    memcpy(bands, frame.bands, frame.band_count * sizeof(float));
+    trace->beat_count[b] = frame.beat_count;
+    trace->published[b]  = (uint32_t)(frame.seq - first);
+  }
+  if (trace != NULL)
+    trace->frames = blocks;
+}
+
+static bool ReplayWriteGolden(const char* path, const ReplayTrace* trace, unsigned rate)
+{
+  FILE* f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+  ReplayGoldenHeader hdr = {REPLAY_GOLDEN_MAGIC, REPLAY_BLOCK, rate, trace->frames,
+                            trace->band_count};
+  bool               ok  = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+  for (size_t i = 0; ok && i < trace->frames; i++)
+  {
+    ok = fwrite(&trace->published[i], sizeof(uint32_t), 1, f) == 1 &&
+         fwrite(&trace->bands[i * BANDS_MAX], sizeof(float), trace->band_count, f) ==
+           trace->band_count &&
+         fwrite(&trace->beat_count[i], sizeof(uint32_t), 1, f) == 1;
+  }
+  return fclose(f) == 0 && ok;
+}
+
+/* Returns the worst band error relative to the golden peak, or a negative value on mismatch */
+static float ReplayCompareGolden(const char* path, const ReplayTrace* trace, unsigned rate,
+                                 int* beat_delta)
+{
+  FILE* f = fopen(path, "rb");
+  if (f == NULL)
+  {
+    printf("    missing golden file %s (run with --record first)\n", path);
+    return -1.0f;
+  }
+
+  ReplayGoldenHeader hdr;
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+      memcmp(hdr.magic, REPLAY_GOLDEN_MAGIC, sizeof(hdr.magic)) != 0 ||
+      hdr.block != REPLAY_BLOCK || hdr.rate != rate || hdr.frames != trace->frames ||
+      hdr.band_count != trace->band_count || hdr.band_count > BANDS_MAX)
+  {
+    printf("    %s does not match this configuration (frames, bands, rate or block size)\n",
+           path);
+    fclose(f);
+    return -1.0f;
+  }
+
+  float    golden[BANDS_MAX];
+  uint32_t golden_beats     = 0;
+  uint32_t golden_published = 0;
+  float    peak             = 0.0f;
+  float    worst            = 0.0f;
+  for (size_t i = 0; i < trace->frames; i++)
+  {
+    if (fread(&golden_published, sizeof(golden_published), 1, f) != 1 ||
+        fread(golden, sizeof(float), hdr.band_count, f) != hdr.band_count ||
+        fread(&golden_beats, sizeof(golden_beats), 1, f) != 1)
+    {
+      printf("    %s is truncated\n", path);
+      fclose(f);
+      return -1.0f;
+    }
+    if (golden_published != trace->published[i])
+    {
+      printf("    block %zu has %u published frames, the golden one %u\n", i,
+             trace->published[i], golden_published);
+      fclose(f);
+      return -1.0f;
+    }
+    const float* bands = &trace->bands[i * BANDS_MAX];
+    for (size_t k = 0; k < hdr.band_count; k++)
+    {
+      float err = fabsf(bands[k] - golden[k]);
+      if (peak < fabsf(golden[k]))
+        peak = fabsf(golden[k]);
+      if (worst < err)
+        worst = err;
+    }
+  }
+  fclose(f);
+  *beat_delta = trace->frames ? (int)trace->beat_count[trace->frames - 1] - (int)golden_beats : 0;
+  return peak > 0.0f ? worst / peak : worst;
+}
+
+static int ReplayRatioCompare(const void* a, const void* b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/* ns per sample from <dir>/baseline.txt, 0 if the case has none */
+static double ReplayBaseline(const char* dir, const char* name)
+{
+  char path[512];
+  snprintf(path, sizeof(path), "%s/baseline.txt", dir);
+  FILE* f = fopen(path, "r");
+  if (f == NULL)
+    return 0.0;
+
+  char   line[256];
+  double ns = 0.0;
+  while (fgets(line, sizeof(line), f))
+  {
+    char   key[128];
+    double value;
+    if (sscanf(line, "%127s %lf", key, &value) == 2 && strcmp(key, name) == 0)
+      ns = value;
+  }
+  fclose(f);
+  return ns;
+}
+
+int run_replay(const char* dir)
+{
+  struct
+  {
+    const char* name;
+    int         engine;
+    int         decimation;
+  } configs[] = {
+    {"fft", ENGINE_FFT, 1},
+    {"fft-bass8", ENGINE_FFT, 8},
+    {"resonator", ENGINE_RESONATOR, 1},
+  };
+  const char*  synth[] = {"tones", "sweep", "kicks"};
+  ReplaySignal signals[ARRAY_LEN(synth) + 1];
+  size_t       signal_count = 0;
+
+  for (size_t i = 0; i < ARRAY_LEN(synth); i++)
+  {
+    if (ReplaySynth(&signals[signal_count], synth[i]))
+      signal_count++;
+  }
+  MappedAudio wav = {0};
+  if (ReplayLoadWave(&signals[signal_count], &wav, "samples/sample-15s.wav"))
+    signal_count++;
+  else
+    printf("[rAVen] samples/sample-15s.wav not readable, replaying synthetic signals only\n");
+
+  FILE* baseline = NULL;
+  if (replayRecord || replayBaseline)
+  {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/baseline.txt", dir);
+    baseline = fopen(path, "w");
+    if (baseline == NULL)
+    {
+      printf("[rAVen] Could not write %s (does the directory exist?)\n", path);
+      return 1;
+    }
+    fprintf(baseline, "# case ns/sample, best of %d runs, %d-frame blocks\n", REPLAY_RUNS,
+            REPLAY_BLOCK);
+  }
+
+  printf("[rAVen] replay: %zu signals x %zu configurations, %d-frame blocks, %s %s\n",
+         signal_count, ARRAY_LEN(configs), REPLAY_BLOCK,
+         replayRecord ? "recording into" : "against", dir);
+
+  int    failures = 0;
+  double ratios[ARRAY_LEN(signals) * ARRAY_LEN(configs)]; // time / baseline per case
+  size_t ratio_count = 0;
+  for (size_t s = 0; s < signal_count; s++)
+  {
+    const ReplaySignal* sig    = &signals[s];
+    size_t              blocks = sig->frames / REPLAY_BLOCK;
+    ReplayTrace         trace  = {0};
+    trace.bands      = malloc(blocks * BANDS_MAX * sizeof(float));
+    trace.beat_count = malloc(blocks * sizeof(uint32_t));
+    trace.published  = malloc(blocks * sizeof(uint32_t));
+    if (trace.bands == NULL || trace.beat_count == NULL || trace.published == NULL)
+    {
+      printf("[rAVen] Out of memory replaying %s\n", sig->name);
+      free(trace.bands);
+      free(trace.beat_count);
+      free(trace.published);
+      failures++;
+      continue;
+    }
+
+    for (size_t c = 0; c < ARRAY_LEN(configs); c++)
+    {
+      char name[128];
+      char path[512];
+      snprintf(name, sizeof(name), "%s.%s", sig->name, configs[c].name);
+      snprintf(path, sizeof(path), "%s/%s.golden", dir, name);
+
+      ReplayRun(sig, configs[c].engine, configs[c].decimation, &trace);
+
+      double best = 0.0;
+      for (int r = 0; r < REPLAY_RUNS; r++)
+      {
+        double start   = ReplayCpuSeconds();
+        ReplayRun(sig, configs[c].engine, configs[c].decimation, NULL);
+        double elapsed = ReplayCpuSeconds() - start;
+        if (r == 0 || elapsed < best)
+          best = elapsed;
+      }
+      double ns = best * 1e9 / (blocks * REPLAY_BLOCK);
+      if (baseline != NULL)
+        fprintf(baseline, "%s %.3f\n", name, ns);
+
+      if (replayRecord)
+      {
+        bool ok = ReplayWriteGolden(path, &trace, sig->rate);
+        printf("  %-24s %s %8.1f ns/sample\n", name, ok ? "recorded" : "FAILED  ", ns);
+        failures += !ok;
+        continue;
+      }
+
+      int    beat_delta = 0;
+      float  err        = ReplayCompareGolden(path, &trace, sig->rate, &beat_delta);
+      double base       = baseline != NULL ? 0.0 : ReplayBaseline(dir, name);
+      bool   spectra_ok = err >= 0.0f && err <= REPLAY_TOLERANCE;
+      printf("  %-24s %s  err %.2e  beats %+d  %8.1f ns/sample", name,
+             spectra_ok ? "ok  " : "FAIL", err < 0.0f ? 0.0f : err, beat_delta, ns);
+      if (base > 0.0)
+      {
+        printf(" (baseline %.1f, %+.1f%%)", base, (ns / base - 1.0) * 100.0);
+        ratios[ratio_count++] = ns / base;
+      }
+      printf("\n");
+      failures += !spectra_ok;
+    }
+    free(trace.bands);
+    free(trace.beat_count);
+    free(trace.published);
+    if (wav.data == NULL || (const unsigned char*)sig->pcm != wav.data)
+      free(sig->pcm);
+  }
+  MappedAudioClose(&wav);
+
+  if (baseline != NULL)
+    fclose(baseline);
+  if (ratio_count > 0)
+  {
+    qsort(ratios, ratio_count, sizeof(double), ReplayRatioCompare);
+    double median = (ratios[(ratio_count - 1) / 2] + ratios[ratio_count / 2]) / 2.0;
+    bool   slow   = replayPerfSlack >= 0.0f && median > 1.0 + replayPerfSlack / 100.0;
+    printf("[rAVen] median speed vs. baseline %+.1f%% over %zu cases%s\n", (median - 1.0) * 100.0,
+           ratio_count, replayPerfSlack < 0.0f ? " (not gated)" : slow ? ": too slow" : "");
+    failures += slow;
+  }
+  printf("[rAVen] replay %s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
+
+void print_usage(const char* prog)
+{
+  printf("Usage: %s [options] <audio file>\n"
+         "       %s [options] --pcm <fifo|-> [--rate=N] [--channels=N] [--format=F]\n\n"
+         "Options:\n"
+         "  --decimate=<1|2|4|8>      Polyphase decimation for the bass bands (1 = off)\n"
+         "  --engine=<fft|resonator>  Spectrum analysis engine\n"
+         "  --bench                   Benchmark the analysis engines and exit\n"
+         "  --replay[=dir]            Check analysis output and speed (default: tests/replay)\n"
+         "  --record[=baseline]       With --replay: write new goldens and baseline (or just it)\n"
+         "  --perf-slack=<pct|off>    With --replay: allowed median slowdown (default %.0f)\n"
+         "  --always-render           Redraw at full rate even when paused or hidden\n"
+         "  --av-offset=<ms>          Extra delay for the visuals, added to the estimated latency\n"
+         "  --device-periods=<n>      Periods the audio device queues if not 3 (latency estimate)\n"
+         "  --startup-stats           Print time to first frame / first audio and each init stage\n"
+         "  --library[=dir]           Index dir (default ~/Music) for the TAB library browser\n"
+         "  --soak[=minutes]          Cycle tracks, seeks, modes and volume (default 60 min) and\n"
+         "                            report RSS, fds and timing trends\n"
+         "  --soak-report=<path>      Where --soak writes its report (default soak-report.txt)\n"
+         "  --shm[=name]              Publish spectrum frames to shared memory (default %s)\n"
+         "  --pcm <path|->            Read raw interleaved PCM from a FIFO/file (mapped) or stdin\n"
+         "  --rate=<hz>               PCM sample rate (default 44100)\n"
+         "  --channels=<n>            PCM channel count (default 2)\n"
+         "  --format=<f32le|s16le|s24le|s32le>  PCM sample format (default f32le)\n",
+         prog, prog, REPLAY_PERF_SLACK, RAVEN_SHM_DEFAULT_NAME);
+}
+
+int parse_args(int argc, char* argv[])
+{
+  const char* song = NULL;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strncmp(argv[i], "--decimate=", 11) == 0)
+    {
+      int d = atoi(argv[i] + 11);
+      if (d != 1 && d != 2 && d != 4 && d != 8)
+      {
+        printf("Error: decimation must be 1, 2, 4 or 8 (got %s)\n", argv[i] + 11);
+        return 1;
+      }
+      atomic_store(&requested_decimation, d);
+    }
+    else if (strncmp(argv[i], "--engine=", 9) == 0)
+    {
+      if (strcmp(argv[i] + 9, "fft") == 0)
+        atomic_store(&requested_engine, ENGINE_FFT);
+      else if (strcmp(argv[i] + 9, "resonator") == 0)
+        atomic_store(&requested_engine, ENGINE_RESONATOR);
+      else
+      {
+        printf("Error: unknown engine %s (expected fft or resonator)\n", argv[i] + 9);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--bench") == 0)
+    {
+      bench_mode = true;
+    }
+    else if (strcmp(argv[i], "--replay") == 0)
+    {
+      replayDir = "tests/replay";
+    }
+    else if (strncmp(argv[i], "--replay=", 9) == 0)
+    {
+      replayDir = argv[i] + 9;
+    }
+    else if (strcmp(argv[i], "--record") == 0)
+    {
+      replayRecord   = true;
+      replayBaseline = true;
+    }
+    else if (strcmp(argv[i], "--record=baseline") == 0)
+    {
+      replayBaseline = true;
+    }
+    else if (strcmp(argv[i], "--perf-slack=off") == 0)
+    {
+      replayPerfSlack = -1.0f;
+    }
+    else if (strncmp(argv[i], "--perf-slack=", 13) == 0)
+    {
+      replayPerfSlack = atof(argv[i] + 13);
+      if (replayPerfSlack < 0.0f)
+      {
+        printf("Error: --perf-slack must not be negative (got %s)\n", argv[i] + 13);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--always-render") == 0)
+    {
+      idleRendering = false;
+    }
+    else if (strcmp(argv[i], "--startup-stats") == 0)
+    {
+      startupStats = true;
+    }
+    else if (strncmp(argv[i], "--device-periods=", 17) == 0)
+    {
+      devicePeriods = atoi(argv[i] + 17);
+      if (devicePeriods < 1 || devicePeriods > 16)
+      {
+        printf("Error: --device-periods must be between 1 and 16 (got %s)\n", argv[i] + 17);
+        return 1;
+      }
+    }
+    else if (strncmp(argv[i], "--av-offset=", 12) == 0)
+    {
+      avOffsetMs = atoi(argv[i] + 12);
+      if (avOffsetMs < -1000 || avOffsetMs > 1000)
+      {
+        printf("Error: --av-offset must be within +-1000 ms (got %s)\n", argv[i] + 12);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--pcm") == 0)
+    {
+      if (i + 1 >= argc)
+      {
+        printf("Error: --pcm needs a path or - for stdin\n");
+        return 1;
+      }
+      pcmPath = argv[++i];
+    }
+    else if (strncmp(argv[i], "--rate=", 7) == 0)
+    {
+      pcmRate = atoi(argv[i] + 7);
+      if (pcmRate < 8000 || pcmRate > 384000)
+      {
+        printf("Error: unsupported PCM rate %s\n", argv[i] + 7);
+        return 1;
+      }
+    }
+    else if (strncmp(argv[i], "--channels=", 11) == 0)
+    {
+      pcmChannels = atoi(argv[i] + 11);
+      if (pcmChannels < 1 || pcmChannels > 8)
+      {
+        printf("Error: unsupported PCM channel count %s\n", argv[i] + 11);
+        return 1;
+      }
+    }
+    else if (strncmp(argv[i], "--format=", 9) == 0)
+    {
+      const char* f = argv[i] + 9;
+      if (strcmp(f, "f32le") == 0)
+        pcmFormat = PCM_F32LE;
+      else if (strcmp(f, "s16le") == 0)
+        pcmFormat = PCM_S16LE;
+      else if (strcmp(f, "s24le") == 0)
+        pcmFormat = PCM_S24LE;
+      else if (strcmp(f, "s32le") == 0)
+        pcmFormat = PCM_S32LE;
+      else
+      {
+        printf("Error: unknown PCM format %s (expected f32le, s16le, s24le or s32le)\n", f);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--library") == 0)
+    {
+      libraryRoot = ""; // ~/Music
+    }
+    else if (strncmp(argv[i], "--library=", 10) == 0)
+    {
+      libraryRoot = argv[i] + 10;
+    }
+    else if (strcmp(argv[i], "--soak") == 0)
+    {
+      soakMinutes = 60.0;
+    }
+    else if (strncmp(argv[i], "--soak=", 7) == 0)
+    {
+      soakMinutes = atof(argv[i] + 7);
+      if (soakMinutes <= 0.0)
+      {
+        printf("Error: --soak needs a positive number of minutes\n");
+        return 1;
+      }
+    }
+    else if (strncmp(argv[i], "--soak-report=", 14) == 0)
+    {
+      soakReportPath = argv[i] + 14;
+    }
+    else if (strcmp(argv[i], "--shm") == 0)
+    {
+      shmName = RAVEN_SHM_DEFAULT_NAME;
+    }
+    else if (strncmp(argv[i], "--shm=", 6) == 0)
+    {
+      shmName = argv[i] + 6;
+      if (shmName[0] != '/')
+      {
+        printf("Error: shared memory names must start with '/' (got %s)\n", shmName);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+    {
+      print_usage(argv[0]);
+      exit(0);
+    }
+    else if (argv[i][0] == '-' && argv[i][1] == '-')
+    {
+      printf("Error: unknown option %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    }
+    else
+    {
+      song = argv[i];
+    }
+  }
+
+  if (bench_mode || replayDir != NULL)
+  {
+    return 0;
+  }
+  if (replayBaseline)
+  {
+    printf("Error: --record only makes sense with --replay\n");
+    return 1;
+  }
+  if (pcmPath != NULL)
+  {
+    if (song != NULL)
+      printf("[rAVen] --pcm given, ignoring %s\n", song);
+    return 0;
+  }
+  if (song == NULL)
+  {
+    printf(" [rAVen]\nNo arguments provided.\n");
+    return 1;
+  }
+  if (!is_song_file(song))
+  {
+    printf("Error: %s is not a valid audio file.\n", song);
+    return 1;
+  }
+  strncpy(selected_song, song, sizeof(selected_song) - 1);
+  printf("Selected song: %s\n", selected_song);
+  return 0;
+}
+
+/*************************************************************
+ *
+ * @PCM INPUT
+ *
+ * Raw interleaved PCM from stdin or a named pipe, e.g.
+ *
+ *   ffmpeg -i song.flac -f f32le - | raven --pcm -
+ *
+ * A reader thread blocks in read(), converts every frame to
+ * float stereo and pushes it into a single-producer /
+ * single-consumer ring of PCM_RING_SECONDS. The main loop
+ * only ever takes what is already there and hands it to a
+ * raylib AudioStream, so the analysis path (callback()) sees
+ * exactly the same data as for files, and nothing on the
+ * render side can block on the pipe:
+ *
+ * -> OVERRUN   the ring was full and the reader had to stall
+ *              (the pipe then back-pressures the writer)
+ * -> UNDERRUN  playback needed a chunk the ring did not have,
+ *              the missing part is played as silence
+ *
+ ************************************************************/
+
+typedef struct
+{
+  int      fd;
+  unsigned rate;
+  unsigned channels;
+  PcmFormat format;
+  pthread_t reader;
+  bool      reader_started;
+
+  float (*ring)[2];
+  size_t           capacity; // frames
+  _Atomic size_t   head;     // frames written, only the reader advances it
+  _Atomic size_t   tail;     // frames consumed, only the main thread advances it
+  _Atomic bool     running;
+  _Atomic bool     eof;
+  _Atomic uint64_t overruns;
+  uint64_t         underruns;
+
+  AudioStream stream;
+  float (*chunk)[2];         // staging for UpdateAudioStream()
+  size_t      chunk_frames; // one stream sub-buffer, 21-23 ms from 44.1 kHz up
+  uint64_t    frames_played;
+} PcmInput;
+
+static size_t PcmFrameBytes(const PcmInput* pcm)
+{
+  return pcm->channels * PcmSampleBytes(pcm->format);
+}
+
+void* PcmReaderThread(void* arg)
+{
+  PcmInput*     pcm         = arg;
+  size_t        frame_bytes = PcmFrameBytes(pcm);
+  unsigned char buf[16384];
+  size_t        have = 0; // bytes in buf, may end in a partial frame
+
+  while (atomic_load(&pcm->running))
+  {
+    ssize_t got = read(pcm->fd, buf + have, sizeof(buf) - have);
+    if (got <= 0)
+      break; // EOF or error, the stream just runs dry
+    have += got;
+
+    size_t frames = have / frame_bytes;
+    for (size_t i = 0; i < frames && atomic_load(&pcm->running);)
+    {
+      size_t head = atomic_load_explicit(&pcm->head, memory_order_relaxed);
+      size_t tail = atomic_load_explicit(&pcm->tail, memory_order_acquire);
+      size_t room = pcm->capacity - (head - tail);
+      if (room == 0)
+      {
+        atomic_fetch_add(&pcm->overruns, 1);
+        while (atomic_load(&pcm->running) &&
+               atomic_load_explicit(&pcm->tail, memory_order_acquire) == tail)
+          usleep(5000);
+        continue;
+      }
+
+      size_t n = frames - i < room ? frames - i : room;
+      for (size_t j = 0; j < n; j++, i++)
+      {
+        const unsigned char* f    = buf + i * frame_bytes;
+        float                l    = PcmSample(f, pcm->format);
+        float                r    = pcm->channels > 1 ? PcmSample(f + frame_bytes / pcm->channels,
+                                                                  pcm->format)
+                                                      : l;
+        float*               slot = pcm->ring[(head + j) % pcm->capacity];
+        slot[0]                   = l;
+        slot[1]                   = r;
+      }
+      atomic_store_explicit(&pcm->head, head + n, memory_order_release);
+    }
+
+    size_t used = frames * frame_bytes;
+    memmove(buf, buf + used, have - used);
+    have -= used;
+  }
+
+  atomic_store(&pcm->eof, true);
+  return NULL;
+}
+
+int PcmInputOpen(PcmInput* pcm, const char* path, unsigned rate, unsigned channels,
+                 PcmFormat format)
+{
+  memset(pcm, 0, sizeof(*pcm));
+  pcm->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+  if (pcm->fd < 0)
+  {
+    printf("[rAVen] Could not open PCM input %s\n", path);
+    return -1;
+  }
+  pcm->rate     = rate;
+  pcm->channels = channels;
+  pcm->format   = format;
+  pcm->capacity = (size_t)rate * PCM_RING_SECONDS;
+  pcm->ring     = calloc(pcm->capacity, sizeof(pcm->ring[0]));
+  // At 96 kHz and up one 1024-frame sub-buffer lasts less than a rendered frame
+  pcm->chunk_frames = PCM_CHUNK_FRAMES * ((rate + 22050) / 44100 + (rate < 22050));
+  pcm->chunk        = calloc(pcm->chunk_frames, sizeof(pcm->chunk[0]));
+  if (pcm->ring == NULL || pcm->chunk == NULL)
+  {
+    free(pcm->ring);
+    free(pcm->chunk);
+    if (pcm->fd != STDIN_FILENO)
+      close(pcm->fd);
+    return -1;
+  }
+
+  SetAudioStreamBufferSizeDefault(pcm->chunk_frames);
+  pcm->stream = LoadAudioStream(rate, 32, 2);
+  SetAudioStreamBufferSizeDefault(0);
+
+  atomic_store(&pcm->running, true);
+  if (pthread_create(&pcm->reader, NULL, PcmReaderThread, pcm) != 0)
+  {
+    printf("[rAVen] Could not start the PCM reader thread\n");
+    UnloadAudioStream(pcm->stream);
+    free(pcm->ring);
+    free(pcm->chunk);
+    if (pcm->fd != STDIN_FILENO)
+      close(pcm->fd);
+    return -1;
+  }
+  pcm->reader_started = true;
+  return 0;
+}
+
+/* Hands one sub-buffer of ring data to the stream; false if the ring ran dry */
+static bool PcmInputPush(PcmInput* pcm)
+{
+  size_t tail  = atomic_load_explicit(&pcm->tail, memory_order_relaxed);
+  size_t head  = atomic_load_explicit(&pcm->head, memory_order_acquire);
+  size_t avail = head - tail;
+  size_t n     = avail < pcm->chunk_frames ? avail : pcm->chunk_frames;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    pcm->chunk[i][0] = pcm->ring[(tail + i) % pcm->capacity][0];
+    pcm->chunk[i][1] = pcm->ring[(tail + i) % pcm->capacity][1];
+  }
+  atomic_store_explicit(&pcm->tail, tail + n, memory_order_release);
+
+  if (n < pcm->chunk_frames)
+  {
+    if (!atomic_load(&pcm->eof))
+      pcm->underruns++;
+    memset(pcm->chunk[n], 0, (pcm->chunk_frames - n) * sizeof(pcm->chunk[0]));
+  }
+  pcm->frames_played += n;
+  UpdateAudioStream(pcm->stream, pcm->chunk, pcm->chunk_frames);
+  return n == pcm->chunk_frames;
+}
+
+/* Called once per main loop iteration, never blocks. Refills every sub-buffer the device
+ * has finished (raylib double-buffers streams), so a slow frame does not starve playback */
+void PcmInputUpdate(PcmInput* pcm)
+{
+  for (int i = 0; i < 2 && IsAudioStreamProcessed(pcm->stream); i++)
+  {
+    if (!PcmInputPush(pcm))
+      break; // one chunk of silence is enough
+  }
+}
+
+void PcmInputClose(PcmInput* pcm)
+{
+  atomic_store(&pcm->running, false);
+  if (pcm->reader_started)
+  {
+    /* The reader may sit in read() on a quiet pipe; cancel it rather than hang on exit */
+    pthread_cancel(pcm->reader);
+    pthread_join(pcm->reader, NULL);
+  }
+  UnloadAudioStream(pcm->stream);
+  free(pcm->ring);
+  free(pcm->chunk);
+  if (pcm->fd >= 0 && pcm->fd != STDIN_FILENO)
+    close(pcm->fd);
+  memset(pcm, 0, sizeof(*pcm));
+}
+
+/*************************************************************
+ *
+ * @MEDIA SOURCE
+ *
+ * What is playing: a mapped WAV or raw file (see @MAPPED
+ * AUDIO), a raylib Music stream for everything else, or a PCM
+ * input. main() only talks to the Source* helpers so the loop
+ * does not care which one it is.
+ *
+ ************************************************************/
+
+typedef enum
+{
+  SOURCE_NONE,
+  SOURCE_MUSIC,
+  SOURCE_PCM,
+  SOURCE_MAPPED
+} SourceKind;
+
+typedef struct
+{
+  SourceKind  kind;
+  Music       music;
+  PcmInput    pcm;
+  MappedAudio mapped;
+} MediaSource;
+
+AudioStream SourceStream(const MediaSource* src)
+{
+  if (src->kind == SOURCE_MAPPED)
+    return src->mapped.stream;
+  return src->kind == SOURCE_PCM ? src->pcm.stream : src->music.stream;
+}
+
+void SourceUnload(MediaSource* src)
+{
+  if (src->kind == SOURCE_MUSIC)
+  {
+    StopMusicStream(src->music);
+    UnloadMusicStream(src->music);
+  }
+  else if (src->kind == SOURCE_PCM)
+  {
+    PcmInputClose(&src->pcm);
+  }
+  else if (src->kind == SOURCE_MAPPED)
+  {
+    MappedAudioClose(&src->mapped);
+  }
+  src->kind = SOURCE_NONE;
+}
+
+void SourceLoadFile(MediaSource* src, const char* path)
+{
+  SourceUnload(src);
+  if (MappedAudioOpenWav(&src->mapped, path) == 0)
+  {
+    src->kind = SOURCE_MAPPED;
+    MappedAudioPlay(&src->mapped);
+    return;
+  }
+  src->music = LoadMusicStream(path);
+  src->kind  = SOURCE_MUSIC;
+  PlayMusicStream(src->music);
+  AttachAnalysis(src->music.stream);
+}
+
+int SourceLoadPcm(MediaSource* src, const char* path)
+{
+  SourceUnload(src);
+
+  // A regular file can be mapped instead of read through the pipe machinery
+  if (strcmp(path, "-") != 0 &&
+      MappedAudioOpenRaw(&src->mapped, path, pcmRate, pcmChannels, pcmFormat) == 0)
+  {
+    src->kind = SOURCE_MAPPED;
+    MappedAudioPlay(&src->mapped);
+    return 0;
+  }
+  if (PcmInputOpen(&src->pcm, path, pcmRate, pcmChannels, pcmFormat) != 0)
+    return -1;
+  src->kind = SOURCE_PCM;
+  PlayAudioStream(src->pcm.stream);
+  AttachAnalysis(src->pcm.stream);
+  return 0;
+}
+
+void SourceUpdate(MediaSource* src)
+{
+  if (src->kind == SOURCE_MUSIC)
+    UpdateMusicStream(src->music);
+  else if (src->kind == SOURCE_PCM)
+    PcmInputUpdate(&src->pcm);
+  else if (src->kind == SOURCE_MAPPED)
+    MappedAudioPrefetch(&src->mapped);
+}
+
+bool SourceIsPlaying(const MediaSource* src)
+{
+  if (src->kind == SOURCE_MUSIC)
+    return IsMusicStreamPlaying(src->music);
+  if (src->kind != SOURCE_NONE)
+    return IsAudioStreamPlaying(SourceStream(src));
+  return false;
+}
+
+void SourcePause(MediaSource* src)
+{
+  if (src->kind == SOURCE_MUSIC)
+    PauseMusicStream(src->music);
+  else if (src->kind != SOURCE_NONE)
+    PauseAudioStream(SourceStream(src));
+}
+
+void SourceResume(MediaSource* src)
+{
+  if (src->kind == SOURCE_MUSIC)
+    ResumeMusicStream(src->music);
+  else if (src->kind != SOURCE_NONE)
+    ResumeAudioStream(SourceStream(src));
+}
+
+void SourceSetVolume(MediaSource* src, float volume)
+{
+  if (src->kind == SOURCE_MUSIC)
+    SetMusicVolume(src->music, volume);
+  else if (src->kind != SOURCE_NONE)
+    SetAudioStreamVolume(SourceStream(src), volume);
+}
+
+float SourceTimePlayed(const MediaSource* src)
+{
+  if (src->kind == SOURCE_MUSIC)
+    return GetMusicTimePlayed(src->music);
+  if (src->kind == SOURCE_PCM)
+    return (float)src->pcm.frames_played / src->pcm.rate;
+  if (src->kind == SOURCE_MAPPED)
+    return (float)(atomic_load(&src->mapped.cursor) % src->mapped.frames) / src->mapped.rate;
+  return 0.0f;
+}
+
+// 0 for live streams
+float SourceTimeLength(const MediaSource* src)
+{
+  if (src->kind == SOURCE_MAPPED)
+    return (float)src->mapped.frames / src->mapped.rate;
+  return src->kind == SOURCE_MUSIC ? GetMusicTimeLength(src->music) : 0.0f;
+}
+
+// Live streams cannot seek
+void SourceSeek(MediaSource* src, float seconds)
+{
+  float length = SourceTimeLength(src);
+  if (length <= 0.0f)
+    return;
+  seconds = fminf(fmaxf(seconds, 0.0f), length);
+  if (src->kind == SOURCE_MUSIC)
+  {
+    SeekMusicStream(src->music, seconds);
+    SeekAnalysis();
+  }
+  else if (src->kind == SOURCE_MAPPED)
+  {
+    MappedAudioSeek(&src->mapped, seconds);
+    SeekAnalysis();
+  }
+}
+
+/*************************************************************
+ *
+ * @STARTUP
+ *
+ * Apart from the window, nothing main() needs before the
+ * first frame depends on anything else: the audio device and
+ * decoder (InitAudioDevice + LoadMusicStream), the avformat
+ * metadata probe and rasterizing the font are tens of ms each
+ * and none of them touch GL. StartupBegin() puts each one on
+ * its own thread before the window is even created, and
+ * StartupFinish() keeps a placeholder on screen until all of
+ * them have reported back.
+ *
+ * The only step left on the main thread is uploading the
+ * font atlas, since LoadTextureFromImage() needs the context.
+ * A stage whose thread cannot be created runs inline instead,
+ * and closing the placeholder window ends startup early.
+ *
+ * $STATS
+ *
+ * --startup-stats prints when each stage finished, in ms
+ * since main() was entered. First audio is the first
+ * non-silent block to reach callback().
+ *
+ ************************************************************/
+
+typedef struct
+{
+  double         start;       // main() entered
+  double         window;      // InitWindow() returned
+  double         first_frame; // placeholder swapped to the screen
+  double         audio;       // device open, source playing
+  double         metadata;
+  double         font;        // atlas uploaded
+  bool           reported;
+  bool           closed; // the window was closed before startup finished
+  MediaSource*   source;
+  MusicMetadata* metadata_out;
+  int            audio_status; // SourceLoadPcm() result
+  Font           font_data;    // glyphs and recs; texture is filled in on the main thread
+  Image          font_atlas;
+  _Atomic bool   audio_done, metadata_done, font_done;
+  pthread_t      audio_thread, metadata_thread, font_thread;
+  bool           audio_threaded, metadata_threaded, font_threaded; // only those are joined
+} Startup;
+
+void* StartupAudio(void* arg)
+{
+  Startup* st = arg;
+  InitAudioDevice();
+  if (pcmPath != NULL)
+  {
+    st->audio_status = SourceLoadPcm(st->source, pcmPath);
+  }
+  else
+  {
+    SourceLoadFile(st->source, selected_song);
+    assert(st->source->kind != SOURCE_MUSIC || st->source->music.stream.sampleSize == 32);
+    assert(st->source->kind != SOURCE_MUSIC || st->source->music.stream.channels == 2);
+  }
+  st->audio = now_seconds();
+  atomic_store(&st->audio_done, true);
+  return NULL;
+}
+
+void* StartupMetadata(void* arg)
+{
+  Startup* st = arg;
+  extract_metadata(selected_song, st->metadata_out);
+  st->metadata = now_seconds();
+  atomic_store(&st->metadata_done, true);
+  return NULL;
+}
+
+// LoadFontEx() minus the texture upload
+void* StartupFont(void* arg)
+{
+  Startup*       st   = arg;
+  Font*          font = &st->font_data;
+  int            size = 0;
+  unsigned char* data = LoadFileData("resources/fonts/monogram.ttf", &size);
+  if (data != NULL)
+  {
+    font->baseSize   = 24;
+    font->glyphCount = 95; // printable ASCII, as LoadFontEx() does for NULL codepoints
+    font->glyphs =
+      LoadFontData(data, size, font->baseSize, NULL, font->glyphCount, FONT_DEFAULT);
+    UnloadFileData(data);
+  }
+  if (font->glyphs != NULL)
+  {
+    font->glyphPadding = 4; // FONT_TTF_DEFAULT_CHARS_PADDING
+    st->font_atlas     = GenImageFontAtlas(font->glyphs, &font->recs, font->glyphCount,
+                                           font->baseSize, font->glyphPadding, 0);
+  }
+  atomic_store(&st->font_done, true);
+  return NULL;
+}
+
+/* Runs stage on its own thread, or right here if that fails; true if a thread was started */
+static bool StartupSpawn(pthread_t* thread, void* (*stage)(void*), Startup* st)
+{
+  if (pthread_create(thread, NULL, stage, st) == 0)
+    return true;
+  printf("[rAVen] Could not start a startup thread, running that stage inline\n");
+  stage(st);
+  return false;
+}
+
+void StartupBegin(Startup* st, MediaSource* source, MusicMetadata* metadata)
+{
+  st->source         = source;
+  st->metadata_out   = metadata;
+  st->audio_threaded = StartupSpawn(&st->audio_thread, StartupAudio, st);
+  st->font_threaded  = StartupSpawn(&st->font_thread, StartupFont, st);
+  if (pcmPath != NULL)
+  {
+    snprintf(metadata->title, sizeof(metadata->title), "%s",
+             strcmp(pcmPath, "-") == 0 ? "stdin" : pcmPath);
+    snprintf(metadata->artist, sizeof(metadata->artist), "Live PCM stream");
+    atomic_store(&st->metadata_done, true);
+  }
+  else
+  {
+    st->metadata_threaded = StartupSpawn(&st->metadata_thread, StartupMetadata, st);
+  }
+}
+
+void DrawStartupPlaceholder(const Startup* st)
+{
+  const char* title = "rAVen";
+  const char* stage = !atomic_load(&st->audio_done)      ? "opening audio..."
+                      : !atomic_load(&st->metadata_done) ? "reading tags..."
+                                                         : "loading font...";
+  BeginDrawing();
+  ClearBackground(BLACK);
+  DrawText(title, (GetScreenWidth() - MeasureText(title, 40)) / 2, GetScreenHeight() / 2 - 40, 40,
+           RAYWHITE);
+  DrawText(stage, (GetScreenWidth() - MeasureText(stage, 20)) / 2, GetScreenHeight() / 2 + 10, 20,
+           GRAY);
+  EndDrawing();
+}
+
+// Shows the placeholder until every stage is done (or the window is closed, see st->closed)
+// and returns the UI font
+Font StartupFinish(Startup* st)
+{
+  Font font     = {0};
+  bool uploaded = false;
+  for (;;)
+  {
+    if (WindowShouldClose())
+    {
+      st->closed = true; // the stages still run to the end, they cannot be interrupted
+      break;
+    }
+    if (!uploaded && atomic_load(&st->font_done))
+    {
+      if (st->font_data.glyphs != NULL)
+      {
+        font         = st->font_data;
+        font.texture = LoadTextureFromImage(st->font_atlas);
+        UnloadImage(st->font_atlas);
+      }
+      else
+      {
+        font = GetFontDefault(); // what LoadFontEx() falls back to
+      }
+      st->font = now_seconds();
+      uploaded = true;
+    }
+    bool audio = atomic_load(&st->audio_done);
+    if (audio && st->audio_status == 0)
+    {
+      SourceUpdate(st->source); // start decoding while the rest finishes
+    }
+    if (uploaded && audio && atomic_load(&st->metadata_done) && st->first_frame > 0.0)
+    {
+      break;
+    }
+    DrawStartupPlaceholder(st);
+    if (st->first_frame == 0.0)
+    {
+      st->first_frame = now_seconds();
+    }
+  }
+
+  if (st->audio_threaded)
+    pthread_join(st->audio_thread, NULL);
+  if (st->font_threaded)
+    pthread_join(st->font_thread, NULL);
+  if (st->metadata_threaded)
+    pthread_join(st->metadata_thread, NULL);
+  return font;
+}
+
+// Once first audio is in, or right away if the source failed
+void StartupReport(Startup* st)
+{
+  bool audible = atomic_load_explicit(&first_audio_seen, memory_order_acquire);
+  if (st->reported || (!audible && st->audio_status == 0))
+  {
+    return;
+  }
+  st->reported = true;
+
+  double stages[]  = {st->window, st->first_frame, st->audio,
+                      pcmPath == NULL ? st->metadata : 0.0, st->font,
+                      audible ? first_audio_time : 0.0};
+  const char* names[] = {"window", "first frame", "audio ready", "metadata", "font",
+                         "first audio"};
+  printf("[rAVen] startup, ms since main():\n");
+  for (size_t i = 0; i < ARRAY_LEN(stages); i++)
+  {
+    if (stages[i] > 0.0)
+      printf("  %-12s %8.1f\n", names[i], (stages[i] - st->start) * 1000.0);
+    else
+      printf("  %-12s %8s\n", names[i], "-");
+  }
+}
+
+/*************************************************************
+ *
+ * @MUSIC LIBRARY
+ *
+ * --library[=dir] (default ~/Music) keeps an index of every
+ * audio file under dir in one file,
+ * $XDG_CACHE_HOME/raven/library.idx (~/.cache/raven/...):
+ * path, size, mtime, the MIME type libmagic sniffed from the
+ * content and the extracted MusicMetadata, as fixed-size
+ * records sorted by path. TAB opens a browser over it; typing
+ * filters on title, artist, album and path, ENTER plays.
+ *
+ * $INDEX
+ *
+ * The main thread only ever mmap()s the index, so browsing
+ * and search work as soon as the window is up, whatever the
+ * library size. The scanner replaces the file with rename(),
+ * so a mapping never sees a half-written index, and bumps
+ * generation; LibraryRefresh() remaps on the next frame.
+ *
+ * $SCANNER
+ *
+ * A scanner thread owns the records. On start it walks the
+ * tree once with lstat() only and probes (libmagic +
+ * extract_metadata()) just the files whose size or mtime
+ * changed since the index was written. After that it sits on
+ * inotify: a written, moved or deleted file touches only its
+ * record, a directory only its subtree. Bursts are coalesced
+ * for LIBRARY_SETTLE_MS before the index is rewritten. Only a
+ * queue overflow falls back to the lstat() walk.
+ *
+ ************************************************************/
+
+#define LIBRARY_MAGIC   "RVNLIB01"
+#define LIBRARY_VERSION 1u
+
+typedef struct
+{
+  char     magic[8]; // LIBRARY_MAGIC
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t count;
+  char     root[LIBRARY_PATH_MAX]; // an index of another tree is not reused
+} LibraryHeader;
+
+typedef struct
+{
+  char          path[LIBRARY_PATH_MAX];
+  uint64_t      size;
+  int64_t       mtime_ns;
+  char          type[48]; // as reported by libmagic
+  MusicMetadata metadata;
+} LibraryRecord;
+
+typedef struct
+{
+  int  wd;
+  char path[LIBRARY_PATH_MAX];
+} LibraryWatch;
+
+typedef struct
+{
+  char             root[LIBRARY_PATH_MAX];
+  char             index_path[LIBRARY_PATH_MAX];
+  pthread_t        thread;
+  bool             started;
+  _Atomic bool     running;
+  _Atomic bool     scanning;   // the startup walk is still going
+  _Atomic unsigned generation; // bumped after every index rewrite
+
+  // Scanner thread only
+  magic_t        magic;
+  int            inotify_fd;
+  LibraryRecord* records;
+  size_t         count, capacity;
+  size_t         sorted; // records[0, sorted) are in path order
+  bool*          seen;   // during a walk: records[i] still exists
+  LibraryWatch*  watches;
+  size_t         watch_count, watch_capacity;
+} LibraryScanner;
+
+/* Main thread view of the index */
+typedef struct
+{
+  void*                map;
+  size_t               map_size;
+  const LibraryRecord* records;
+  size_t               count;
+  unsigned             generation;
+} LibraryView;
+
+LibraryScanner libraryScanner = {.inotify_fd = -1};
+LibraryView    libraryView    = {0};
+
+/* The index header if path holds a valid index of root, mapped read-only into *map */
+static const LibraryHeader* LibraryMapIndex(const char* path, const char* root, void** map,
+                                            size_t* size)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  void*       m = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(LibraryHeader))
+    m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED)
+    return NULL;
+
+  const LibraryHeader* hdr = m;
+  if (memcmp(hdr->magic, LIBRARY_MAGIC, 8) != 0 || hdr->version != LIBRARY_VERSION ||
+      hdr->record_size != sizeof(LibraryRecord) ||
+      hdr->count > (st.st_size - sizeof(LibraryHeader)) / sizeof(LibraryRecord) ||
+      strncmp(hdr->root, root, sizeof(hdr->root)) != 0)
+  {
+    munmap(m, st.st_size);
+    return NULL;
+  }
+  *map  = m;
+  *size = st.st_size;
+  return hdr;
+}
+
+static int LibraryPathCompare(const void* a, const void* b)
+{
+  return strcmp(((const LibraryRecord*)a)->path, ((const LibraryRecord*)b)->path);
+}
+
+static int LibraryKeyCompare(const void* key, const void* record)
+{
+  return strcmp(key, ((const LibraryRecord*)record)->path);
+}
+
+static LibraryRecord* LibraryFind(LibraryScanner* sc, const char* path)
+{
+  return bsearch(path, sc->records, sc->sorted, sizeof(LibraryRecord), LibraryKeyCompare);
+}
+
+static void LibrarySort(LibraryScanner* sc)
+{
+  qsort(sc->records, sc->count, sizeof(LibraryRecord), LibraryPathCompare);
+  sc->sorted = sc->count;
+}
+
+static LibraryRecord* LibraryAppend(LibraryScanner* sc)
+{
+  if (sc->count == sc->capacity)
+  {
+    size_t         capacity = sc->capacity ? sc->capacity * 2 : 256;
+    LibraryRecord* records  = realloc(sc->records, capacity * sizeof(LibraryRecord));
+    if (records == NULL)
+      return NULL;
+    sc->records  = records;
+    sc->capacity = capacity;
+  }
+  return &sc->records[sc->count++];
+}
+
+/* Removes path, or everything under it if it is a directory */
+static bool LibraryRemove(LibraryScanner* sc, const char* path)
+{
+  size_t len = strlen(path), kept = 0;
+  for (size_t i = 0; i < sc->count; i++)
+  {
+    const char* p    = sc->records[i].path;
+    bool        gone = strncmp(p, path, len) == 0 && (p[len] == '\0' || p[len] == '/');
+    if (!gone)
+      sc->records[kept++] = sc->records[i];
+  }
+  bool changed = kept != sc->count;
+  sc->count    = kept;
+  sc->sorted   = kept; // removing keeps the order
+  return changed;
+}
+
+/* Sniffs and probes path into rec; false if it is not (or no longer) a playable audio file */
+static bool LibraryProbe(LibraryScanner* sc, const char* path, const struct stat* st,
+                         LibraryRecord* rec)
+{
+  if (!HasSongExtension(path))
+    return false;
+  const char* type = AudioSniff(sc->magic, path);
+  if (type == NULL)
+    return false;
+
+  memset(rec, 0, sizeof(*rec));
+  snprintf(rec->path, sizeof(rec->path), "%s", path);
+  snprintf(rec->type, sizeof(rec->type), "%s", type);
+  rec->size     = st->st_size;
+  rec->mtime_ns = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+  extract_metadata(path, &rec->metadata);
+  return true;
+}
+
+/* Brings the record for one regular file up to date; true if the index changed */
+static bool LibraryUpdateFile(LibraryScanner* sc, const char* path, const struct stat* st)
+{
+  LibraryRecord* rec   = LibraryFind(sc, path);
+  int64_t        mtime = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+  if (rec != NULL && sc->seen != NULL)
+    sc->seen[rec - sc->records] = true;
+  if (rec != NULL && rec->size == (uint64_t)st->st_size && rec->mtime_ns == mtime)
+    return false;
+
+  LibraryRecord probed;
+  if (!LibraryProbe(sc, path, st, &probed))
+  {
+    if (rec == NULL)
+      return false;
+    if (sc->seen == NULL)
+      return LibraryRemove(sc, path);
+    // Mid-walk, removing would shift records under seen[]: leave it unseen, so the end of
+    // LibraryReconcile() prunes it
+    sc->seen[rec - sc->records] = false;
+    return true;
+  }
+  if (rec == NULL)
+  {
+    rec = LibraryAppend(sc);
+    if (rec == NULL)
+      return false;
+    if (sc->seen == NULL)
+    {
+      *rec = probed;
+      LibrarySort(sc); // single events are rare, keep the array searchable right away
+      return true;
+    }
+  }
+  *rec = probed;
+  return true;
+}
+
+static void LibraryAddWatch(LibraryScanner* sc, const char* dir)
+{
+  if (sc->inotify_fd < 0)
+    return;
+  int wd = inotify_add_watch(sc->inotify_fd, dir,
+                             IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                               IN_ONLYDIR | IN_DONT_FOLLOW);
+  if (wd < 0)
+  {
+    printf("[rAVen] Cannot watch %s for library changes: %s\n", dir, strerror(errno));
+    return;
+  }
+  for (size_t i = 0; i < sc->watch_count; i++)
+  {
+    if (sc->watches[i].wd == wd) // the same directory again, e.g. moved within the tree
+    {
+      snprintf(sc->watches[i].path, sizeof(sc->watches[i].path), "%s", dir);
+      return;
+    }
+  }
+  if (sc->watch_count == sc->watch_capacity)
+  {
+    size_t        capacity = sc->watch_capacity ? sc->watch_capacity * 2 : 64;
+    LibraryWatch* watches  = realloc(sc->watches, capacity * sizeof(LibraryWatch));
+    if (watches == NULL)
+      return;
+    sc->watches        = watches;
+    sc->watch_capacity = capacity;
+  }
+  sc->watches[sc->watch_count].wd = wd;
+  snprintf(sc->watches[sc->watch_count].path, LIBRARY_PATH_MAX, "%s", dir);
+  sc->watch_count++;
+}
+
+/* Stops watching dir and everything below it */
+static void LibraryDropWatches(LibraryScanner* sc, const char* dir)
+{
+  size_t len = strlen(dir), kept = 0;
+  for (size_t i = 0; i < sc->watch_count; i++)
+  {
+    const char* p = sc->watches[i].path;
+    if (strncmp(p, dir, len) == 0 && (p[len] == '\0' || p[len] == '/'))
+      inotify_rm_watch(sc->inotify_fd, sc->watches[i].wd);
+    else
+      sc->watches[kept++] = sc->watches[i];
+  }
+  sc->watch_count = kept;
+}
+
+/* lstat() walk below dir, probing only new or changed files; true if the index changed */
+static bool LibraryWalk(LibraryScanner* sc, const char* dir)
+{
+  DIR* d = opendir(dir);
+  if (d == NULL)
+    return false;
+  LibraryAddWatch(sc, dir);
+
+  bool           changed = false;
+  struct dirent* entry;
+  while ((entry = readdir(d)) != NULL && atomic_load(&sc->running))
+  {
+    if (entry->d_name[0] == '.') // ., .. and hidden files
+      continue;
+    char path[LIBRARY_PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) >= (int)sizeof(path))
+      continue;
+    struct stat st;
+    if (lstat(path, &st) != 0) // symlinks are not followed, so there are no cycles
+      continue;
+    if (S_ISDIR(st.st_mode))
+      changed |= LibraryWalk(sc, path);
+    else if (S_ISREG(st.st_mode))
+      changed |= LibraryUpdateFile(sc, path, &st);
+  }
+  closedir(d);
+  return changed;
+}
+
+/* Full reconciliation against the tree: at startup and after an inotify overflow */
+static bool LibraryReconcile(LibraryScanner* sc)
+{
+  LibrarySort(sc);
+  sc->seen = calloc(sc->count + 1, sizeof(bool));
+  if (sc->seen == NULL)
+    return false;
+  size_t known   = sc->count;
+  bool   changed = LibraryWalk(sc, sc->root);
+
+  // Records that were not met on the walk are gone; new ones were appended after known
+  size_t kept = 0;
+  for (size_t i = 0; i < sc->count; i++)
+  {
+    if (i >= known || sc->seen[i])
+      sc->records[kept++] = sc->records[i];
+  }
+  changed |= kept != sc->count;
+  sc->count = kept;
+  free(sc->seen);
+  sc->seen = NULL;
+  LibrarySort(sc);
+  return changed;
+}
+
+static void LibraryWriteIndex(LibraryScanner* sc)
+{
+  char tmp[LIBRARY_PATH_MAX + 8];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", sc->index_path);
+  FILE* f = fopen(tmp, "wb");
+  if (f == NULL)
+  {
+    printf("[rAVen] Cannot write library index %s: %s\n", tmp, strerror(errno));
+    return;
+  }
+
+  LibraryHeader hdr = {.version = LIBRARY_VERSION, .record_size = sizeof(LibraryRecord),
+                       .count = sc->count};
+  memcpy(hdr.magic, LIBRARY_MAGIC, sizeof(hdr.magic));
+  snprintf(hdr.root, sizeof(hdr.root), "%s", sc->root);
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+            fwrite(sc->records, sizeof(LibraryRecord), sc->count, f) == sc->count;
+  ok &= fclose(f) == 0;
+  if (!ok || rename(tmp, sc->index_path) != 0)
+  {
+    printf("[rAVen] Cannot write library index %s\n", sc->index_path);
+    unlink(tmp);
+    return;
+  }
+  atomic_fetch_add(&sc->generation, 1);
+}
+
+/* Drains the inotify queue; true if the index changed */
+static bool LibraryHandleEvents(LibraryScanner* sc)
+{
+  char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = false;
+  for (;;)
+  {
+    ssize_t len = read(sc->inotify_fd, buf, sizeof(buf));
+    if (len <= 0)
+      return changed; // EAGAIN: drained
+
+    for (char* p = buf; p < buf + len;)
+    {
+      const struct inotify_event* ev = (const struct inotify_event*)p;
+      p += sizeof(struct inotify_event) + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW)
+      {
+        changed |= LibraryReconcile(sc);
+        continue;
+      }
+      const char* dir = NULL;
+      for (size_t i = 0; i < sc->watch_count && dir == NULL; i++)
+      {
+        if (sc->watches[i].wd == ev->wd)
+          dir = sc->watches[i].path;
+      }
+      if (dir == NULL || ev->len == 0 || ev->name[0] == '.')
+        continue;
+
+      char path[LIBRARY_PATH_MAX];
+      if (snprintf(path, sizeof(path), "%s/%s", dir, ev->name) >= (int)sizeof(path))
+        continue;
+      struct stat st;
+      if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+      {
+        if (ev->mask & IN_ISDIR)
+          LibraryDropWatches(sc, path);
+        changed |= LibraryRemove(sc, path);
+      }
+      else if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)))
+      {
+        changed |= LibraryWalk(sc, path); // also picks up files that were moved in with it
+      }
+      else if ((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && lstat(path, &st) == 0 &&
+               S_ISREG(st.st_mode))
+      {
+        changed |= LibraryUpdateFile(sc, path, &st);
+      }
+    }
+  }
+}
+
+void* LibraryScannerThread(void* arg)
+{
+  LibraryScanner* sc = arg;
+
+  // Start from the previous index so unchanged files are not probed again
+  void*                map  = NULL;
+  size_t               size = 0;
+  const LibraryHeader* hdr  = LibraryMapIndex(sc->index_path, sc->root, &map, &size);
+  if (hdr != NULL)
+  {
+    sc->records = malloc((hdr->count + 1) * sizeof(LibraryRecord));
+    if (sc->records != NULL)
+    {
+      memcpy(sc->records, hdr + 1, hdr->count * sizeof(LibraryRecord));
+      sc->count    = hdr->count;
+      sc->capacity = hdr->count + 1;
+    }
+    munmap(map, size);
+  }
+
+  bool changed = LibraryReconcile(sc);
+  if (changed || hdr == NULL)
+    LibraryWriteIndex(sc);
+  atomic_store(&sc->scanning, false);
+
+  double last_event = 0.0;
+  bool   pending    = false;
+  while (atomic_load(&sc->running))
+  {
+    struct pollfd pfd = {sc->inotify_fd, POLLIN, 0};
+    if (poll(&pfd, 1, 250) > 0 && LibraryHandleEvents(sc))
+    {
+      pending    = true;
+      last_event = now_seconds();
+    }
+    if (pending && now_seconds() - last_event >= LIBRARY_SETTLE_MS / 1000.0)
+    {
+      LibraryWriteIndex(sc);
+      pending = false;
+    }
+  }
+  if (pending)
+    LibraryWriteIndex(sc);
+  return NULL;
+}
+
+void LibraryViewClose(LibraryView* view)
+{
+  if (view->map != NULL)
+    munmap(view->map, view->map_size);
+  view->map     = NULL;
+  view->records = NULL;
+  view->count   = 0;
+}
+
+/* Main thread, once per frame: maps the index the scanner last wrote; true if it changed */
+bool LibraryRefresh(LibraryView* view, LibraryScanner* sc)
+{
+  unsigned generation = atomic_load(&sc->generation);
+  if (!sc->started || generation == view->generation)
+    return false;
+
+  void*                map  = NULL;
+  size_t               size = 0;
+  const LibraryHeader* hdr  = LibraryMapIndex(sc->index_path, sc->root, &map, &size);
+  if (hdr == NULL) // e.g. mid-rename or a transient open()/mmap() error: try again next frame
+    return false;
+  LibraryViewClose(view);
+  view->map        = map;
+  view->map_size   = size;
+  view->records    = (const LibraryRecord*)(hdr + 1);
+  view->count      = hdr->count;
+  view->generation = generation;
+  return true;
+}
+
+/* Maps the existing index right away and starts the scanner; root NULL or "" means ~/Music */
+void LibraryStart(LibraryScanner* sc, LibraryView* view, const char* root)
+{
+  const char* home  = getenv("HOME") ? getenv("HOME") : ".";
+  const char* cache = getenv("XDG_CACHE_HOME");
+  char        dir[LIBRARY_PATH_MAX];
+  char        path[LIBRARY_PATH_MAX];
+
+  snprintf(path, sizeof(path), "%s/Music", home);
+  if (realpath(root != NULL && root[0] ? root : path, sc->root) == NULL)
+  {
+    printf("[rAVen] Library folder %s not found\n", root != NULL && root[0] ? root : path);
+    return;
+  }
+
+  if (cache != NULL && cache[0])
+    snprintf(dir, sizeof(dir), "%s", cache);
+  else
+    snprintf(dir, sizeof(dir), "%s/.cache", home);
+  mkdir(dir, 0755);
+  snprintf(path, sizeof(path), "%s/raven", dir);
+  mkdir(path, 0755);
+  snprintf(sc->index_path, sizeof(sc->index_path), "%s/library.idx", path);
+
+  sc->started = true;
+  atomic_store(&sc->generation, 1); // view->generation is 0, so the first refresh maps
+  LibraryRefresh(view, sc);
+
+  sc->magic      = AudioMagicOpen();
+  sc->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (sc->inotify_fd < 0)
+    printf("[rAVen] inotify unavailable, the library is only rescanned at startup\n");
+  atomic_store(&sc->running, true);
+  atomic_store(&sc->scanning, true);
+  if (pthread_create(&sc->thread, NULL, LibraryScannerThread, sc) != 0)
+  {
+    printf("[rAVen] Could not start the library scanner\n");
+    atomic_store(&sc->running, false);
+    atomic_store(&sc->scanning, false); // the mapped index is still browsable
+  }
+}
+
+void LibraryStop(LibraryScanner* sc)
+{
+  if (atomic_load(&sc->running))
+  {
+    atomic_store(&sc->running, false);
+    pthread_join(sc->thread, NULL);
+  }
+  if (sc->inotify_fd >= 0)
+    close(sc->inotify_fd);
+  if (sc->magic != NULL)
+    magic_close(sc->magic);
+  free(sc->records);
+  free(sc->watches);
+}
+
+/*************************************************************
+ *
+ * $BROWSER
+ *
+ * While it is open the browser owns the keyboard: letters go
+ * into the search filter, the arrows move the selection, so
+ * main() asks ShortcutPressed() instead of IsKeyPressed().
+ *
+ ************************************************************/
+
+typedef struct
+{
+  bool      open;
+  char      filter[64];
+  size_t    selected; // index into matches
+  size_t    scroll;
+  uint32_t* matches; // record indices passing the filter
+  size_t    match_count, match_capacity;
+  char      matched_filter[64];
+  unsigned  matched_generation;
+} LibraryBrowser;
+
+LibraryBrowser libraryBrowser = {0};
+
+/* What the retained browser panel depends on */
+typedef struct
+{
+  unsigned generation;
+  bool     scanning;
+  size_t   selected, scroll, matches;
+  char     filter[64];
+} LibraryKey;
+
+bool ShortcutPressed(int key) { return !libraryBrowser.open && IsKeyPressed(key); }
+
+static bool ContainsNoCase(const char* haystack, const char* needle, size_t len)
+{
+  for (; *haystack; haystack++)
+  {
+    size_t i = 0;
+    while (i < len && haystack[i] && tolower((unsigned char)haystack[i]) == needle[i])
+      i++;
+    if (i == len)
+      return true;
+  }
+  return len == 0;
+}
+
+/* Every word of the filter appears in the title, artist, album or path */
+static bool LibraryMatches(const LibraryRecord* rec, const char* filter)
+{
+  for (const char* word = filter; *word;)
+  {
+    size_t len = strcspn(word, " ");
+    if (len > 0 && !ContainsNoCase(rec->metadata.title, word, len) &&
+        !ContainsNoCase(rec->metadata.artist, word, len) &&
+        !ContainsNoCase(rec->metadata.album, word, len) && !ContainsNoCase(rec->path, word, len))
+      return false;
+    word += len + (word[len] == ' ');
+  }
+  return true;
+}
+
+static void LibraryBrowserFilter(LibraryBrowser* b, const LibraryView* view)
+{
+  if (b->matches != NULL && b->matched_generation == view->generation &&
+      strcmp(b->matched_filter, b->filter) == 0)
+    return;
 
-  if (argc > 1)
+  if (b->match_capacity < view->count)
   {
-    if (is_song_file(argv[1]))
+    uint32_t* matches = realloc(b->matches, view->count * sizeof(uint32_t));
+    if (matches == NULL)
+      return;
+    b->matches        = matches;
+    b->match_capacity = view->count;
+  }
+  b->match_count = 0;
+  for (size_t i = 0; i < view->count; i++)
+  {
+    if (LibraryMatches(&view->records[i], b->filter))
+      b->matches[b->match_count++] = i;
+  }
+  if (b->selected >= b->match_count)
+    b->selected = b->match_count ? b->match_count - 1 : 0;
+  snprintf(b->matched_filter, sizeof(b->matched_filter), "%s", b->filter);
+  b->matched_generation = view->generation;
+}
+
+void LibraryBrowserToggle(LibraryBrowser* b)
+{
+  b->open = !b->open;
+  while (GetCharPressed() != 0) // keys typed as shortcuts before are not a search
+  {
+  }
+}
+
+/* Keyboard handling while open; returns the record to play, or NULL */
+const LibraryRecord* LibraryBrowserInput(LibraryBrowser* b, const LibraryView* view)
+{
+  size_t len = strlen(b->filter);
+  int    c;
+  while ((c = GetCharPressed()) != 0)
+  {
+    if (c >= 32 && c < 127 && len + 1 < sizeof(b->filter))
     {
-      strcpy(selected_song, argv[1]);
-      printf("Selected song: %s\n", selected_song);
+      b->filter[len++] = (char)tolower(c);
+      b->filter[len]   = '\0';
+      b->selected      = 0;
     }
+  }
+  if ((IsKeyPressed(KEY_BACKSPACE) || IsKeyPressedRepeat(KEY_BACKSPACE)) && len > 0)
+  {
+    b->filter[len - 1] = '\0';
+    b->selected        = 0;
+  }
+  LibraryBrowserFilter(b, view);
+
+  if ((IsKeyPressed(KEY_DOWN) || IsKeyPressedRepeat(KEY_DOWN)) && b->selected + 1 < b->match_count)
+    b->selected++;
+  if ((IsKeyPressed(KEY_UP) || IsKeyPressedRepeat(KEY_UP)) && b->selected > 0)
+    b->selected--;
+  if (b->selected < b->scroll)
+    b->scroll = b->selected;
+  if (b->selected >= b->scroll + LIBRARY_ROWS)
+    b->scroll = b->selected - LIBRARY_ROWS + 1;
+
+  if (IsKeyPressed(KEY_ENTER) && b->match_count > 0)
+  {
+    b->open = false;
+    return &view->records[b->matches[b->selected]];
+  }
+  return NULL;
+}
+
+void DrawLibraryBrowser(const LibraryBrowser* b, const LibraryView* view, Font font,
+                        Rectangle box, bool scanning)
+{
+  DrawRectangle(box.x - 10, box.y - 10, box.width + 20, box.height + 20, GRUVBOX_AQUA);
+  DrawRectangleRec(box, ColorAlpha(GRUVBOX_BG, 0.95f));
+
+  char header[128];
+  snprintf(header, sizeof(header), "Library: %s_", b->filter);
+  DrawTextEx(font, header, (Vector2){box.x + 20, box.y + 15}, 24, 1, GRUVBOX_YELLOW);
+  char counts[64];
+  snprintf(counts, sizeof(counts), "%zu / %zu tracks%s", b->match_count, view->count,
+           scanning ? ", scanning..." : "");
+  Vector2 countsSize = MeasureTextEx(font, counts, 20, 1);
+  DrawTextEx(font, counts, (Vector2){box.x + box.width - 20 - countsSize.x, box.y + 18}, 20, 1,
+             GRUVBOX_FG);
+
+  for (size_t row = 0; row < LIBRARY_ROWS && b->scroll + row < b->match_count; row++)
+  {
+    size_t               i   = b->scroll + row;
+    const LibraryRecord* rec = &view->records[b->matches[i]];
+    const char*          file = strrchr(rec->path, '/') ? strrchr(rec->path, '/') + 1 : rec->path;
+    float                y    = box.y + 55 + row * 26;
+
+    char line[256], label[256];
+    if (rec->metadata.title[0] && strcmp(rec->metadata.title, "Unknown Title") != 0)
+      snprintf(line, sizeof(line), "%s - %s", rec->metadata.title, rec->metadata.artist);
     else
+      snprintf(line, sizeof(line), "%s", file);
+    LimitText(label, line, 70);
+
+    if (i == b->selected)
+      DrawRectangle(box.x + 10, y - 2, box.width - 20, 26, ColorAlpha(GRUVBOX_PURPLE, 0.6f));
+    DrawTextEx(font, label, (Vector2){box.x + 20, y}, 20, 1,
+               i == b->selected ? WHITE : GRUVBOX_FG);
+  }
+  DrawTextEx(font, "type to search   <UP/DOWN> select   <ENTER> play   <TAB> close",
+             (Vector2){box.x + 20, box.y + box.height - 30}, 20, 1, GRUVBOX_AQUA);
+}
+
+/*************************************************************
+ *
+ * @SOAK TEST
+ *
+ * --soak[=minutes] (default 60) drives the normal player the
+ * way a long running kiosk is used, only much faster:
+ *
+ * -> every SOAK_TRACK_SECONDS the next track is loaded through
+ *    the same calls as a file drop (SourceLoadFile(),
+ *    extract_metadata()); tracks come from the library when
+ *    --library is on, else from the song's folder
+ * -> every SOAK_ACTION_SECONDS a seek, a mode switch or a
+ *    volume change, from a fixed-seed generator so two runs
+ *    do the same thing
+ * -> every SOAK_SAMPLE_SECONDS a sample: RSS, open fds and the
+ *    callback() / frame work percentiles of the interval (see
+ *    @TIMING HISTOGRAMS)
+ *
+ * $REPORT
+ *
+ * At the end (or when the window is closed) the samples go to
+ * --soak-report (default soak-report.txt) together with a
+ * least-squares trend per metric, fitted after the first
+ * quarter of the run so start-up allocations and cold caches
+ * do not count. A metric whose fitted rise over the run
+ * exceeds both its absolute and its relative threshold is
+ * flagged RISING and rAVen exits with status 1.
+ *
+ ************************************************************/
+
+typedef struct
+{
+  double   t; // s since the soak started
+  double   rss_mb;
+  int      fds;
+  unsigned tracks; // loaded so far
+  double   callback_p50, callback_p99, callback_max;
+  double   frame_p50, frame_p99, frame_max;
+} SoakSample;
+
+typedef struct
+{
+  const char* name;
+  const char* unit;
+  double      scale;    // from the sample's unit to the reported one
+  size_t      offset;   // of the double in SoakSample, or SIZE_MAX for fds
+  double      abs_rise; // in reported units
+  double      rel_rise; // fraction of the fitted starting value
+} SoakMetric;
+
+static const SoakMetric soakMetrics[] = {
+  {"rss", "MB", 1.0, offsetof(SoakSample, rss_mb), 8.0, 0.05},
+  {"open fds", "", 1.0, SIZE_MAX, 2.0, 0.0},
+  {"callback p50", "us", 1e6, offsetof(SoakSample, callback_p50), 20.0, 0.20},
+  {"callback p99", "us", 1e6, offsetof(SoakSample, callback_p99), 50.0, 0.20},
+  {"frame p50", "ms", 1e3, offsetof(SoakSample, frame_p50), 0.5, 0.20},
+  {"frame p99", "ms", 1e3, offsetof(SoakSample, frame_p99), 1.0, 0.20},
+};
+
+typedef struct
+{
+  bool        active;
+  double      start, end;
+  double      next_track, next_action, next_sample;
+  uint64_t    rng;
+  char**      tracks; // the song's folder, used when there is no library
+  size_t      track_count, track_index;
+  unsigned    loads, seeks, mode_switches, volume_changes;
+  SoakSample* samples;
+  size_t      sample_count, sample_capacity;
+} SoakTest;
+
+SoakTest soakTest = {0};
+
+static uint32_t SoakRandom(SoakTest* soak)
+{
+  soak->rng ^= soak->rng << 13; // xorshift64
+  soak->rng ^= soak->rng >> 7;
+  soak->rng ^= soak->rng << 17;
+  return (uint32_t)(soak->rng >> 32);
+}
+
+static double SoakRssMb(void)
+{
+  long  pages = 0, resident = 0;
+  FILE* f     = fopen("/proc/self/statm", "r");
+  if (f == NULL)
+    return 0.0;
+  if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+    resident = 0;
+  fclose(f);
+  return resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+static int SoakOpenFds(void)
+{
+  DIR* d = opendir("/proc/self/fd");
+  if (d == NULL)
+    return -1;
+  int count = 0;
+  while (readdir(d) != NULL)
+    count++;
+  closedir(d);
+  return count - 3; // ., .. and the fd of d itself
+}
+
+/* Gathers the playable files next to song into the track list; false if out of memory */
+static bool SoakCollectFolder(SoakTest* soak, const char* song)
+{
+  char  folder[LIBRARY_PATH_MAX];
+  char* slash = strrchr(song, '/');
+  if (slash != NULL)
+    snprintf(folder, sizeof(folder), "%.*s", (int)(slash - song), song);
+  else
+    snprintf(folder, sizeof(folder), ".");
+
+  DIR* d = opendir(folder);
+  if (d != NULL)
+  {
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL)
     {
-      printf("Error: %s is not a valid audio file.\n", argv[1]);
-      return 1;
+      char path[LIBRARY_PATH_MAX];
+      if (entry->d_name[0] == '.' ||
+          snprintf(path, sizeof(path), "%s/%s", folder, entry->d_name) >= (int)sizeof(path))
+        continue;
+      if (!is_song_file(path))
+        continue;
+      char** tracks = realloc(soak->tracks, (soak->track_count + 1) * sizeof(char*));
+      char*  copy   = tracks != NULL ? strdup(path) : NULL;
+      if (tracks != NULL)
+        soak->tracks = tracks;
+      if (copy == NULL)
+        break;
+      soak->tracks[soak->track_count++] = copy;
     }
+    closedir(d);
   }
-  else
+  if (soak->track_count == 0) // at least replay the song itself
+  {
+    char** tracks = realloc(soak->tracks, sizeof(char*));
+    char*  copy   = tracks != NULL ? strdup(song) : NULL;
+    if (tracks != NULL)
+      soak->tracks = tracks;
+    if (copy == NULL)
+      return false;
+    soak->tracks[soak->track_count++] = copy;
+  }
+  return true;
+}
+
+bool SoakStart(SoakTest* soak, double minutes, const char* song, double now)
+{
+  if (song != NULL && song[0] && !SoakCollectFolder(soak, song))
+  {
+    printf("[rAVen] Out of memory collecting the soak test tracks\n");
+    free(soak->tracks);
+    soak->tracks = NULL;
+    return false;
+  }
+  soak->active      = true;
+  soak->start       = now;
+  soak->end         = now + minutes * 60.0;
+  soak->next_track  = now + SOAK_TRACK_SECONDS;
+  soak->next_action = now + SOAK_ACTION_SECONDS;
+  soak->next_sample = now + SOAK_SAMPLE_SECONDS;
+  soak->rng         = 0x9E3779B97F4A7C15ull;
+  idleRendering = false; // a paused player would block in event waiting and stop the script
+  atomic_store(&timingEnabled, true);
+  printf("[rAVen] Soak test for %.0f min, a sample every %.0f s\n", minutes, SOAK_SAMPLE_SECONDS);
+  return true;
+}
+
+static void SoakSampleNow(SoakTest* soak, double now)
+{
+  if (soak->sample_count == soak->sample_capacity)
+  {
+    size_t      capacity = soak->sample_capacity ? soak->sample_capacity * 2 : 128;
+    SoakSample* samples  = realloc(soak->samples, capacity * sizeof(SoakSample));
+    if (samples == NULL)
+      return;
+    soak->samples         = samples;
+    soak->sample_capacity = capacity;
+  }
+
+  uint32_t    counts[SOAK_HIST_BINS];
+  SoakSample* s = &soak->samples[soak->sample_count++];
+  s->t          = now - soak->start;
+  s->rss_mb     = SoakRssMb();
+  s->fds        = SoakOpenFds();
+  s->tracks     = soak->loads;
+
+  uint64_t total  = TimingDrain(&callbackTimes, counts);
+  s->callback_p50 = TimingPercentile(counts, total, 0.50);
+  s->callback_p99 = TimingPercentile(counts, total, 0.99);
+  s->callback_max = TimingPercentile(counts, total, 1.00);
+  total           = TimingDrain(&frameWorkTimes, counts);
+  s->frame_p50    = TimingPercentile(counts, total, 0.50);
+  s->frame_p99    = TimingPercentile(counts, total, 0.99);
+  s->frame_max    = TimingPercentile(counts, total, 1.00);
+
+  printf("[rAVen] soak %6.0f s: rss %.1f MB, %d fds, %u tracks, callback p99 %.0f us, "
+         "frame p99 %.2f ms\n",
+         s->t, s->rss_mb, s->fds, s->tracks, s->callback_p99 * 1e6, s->frame_p99 * 1e3);
+}
+
+/* Once per main loop iteration; false once the soak time is over */
+bool SoakStep(SoakTest* soak, MediaSource* source, MusicMetadata* metadata, float* volume,
+              double now)
+{
+  if (now >= soak->next_track)
+  {
+    const char* path = NULL;
+    if (libraryView.count > 0)
+      path = libraryView.records[soak->track_index % libraryView.count].path;
+    else if (soak->track_count > 0)
+      path = soak->tracks[soak->track_index % soak->track_count];
+    soak->track_index++;
+    if (path != NULL)
+    {
+      snprintf(selected_song, sizeof(selected_song), "%s", path);
+      SourceLoadFile(source, selected_song);
+      SourceSetVolume(source, *volume);
+      extract_metadata(selected_song, metadata);
+      soak->loads++;
+    }
+    soak->next_track += SOAK_TRACK_SECONDS;
+  }
+
+  if (now >= soak->next_action)
+  {
+    uint32_t r = SoakRandom(soak);
+    switch (r % 4)
+    {
+    case 0:
+      SwitchVisualizationModeForward();
+      soak->mode_switches++;
+      break;
+    case 1:
+      SwitchVisualizationModeBackward();
+      soak->mode_switches++;
+      break;
+    case 2:
+      SourceSeek(source, SourceTimeLength(source) * (r >> 8) / (float)(1u << 24));
+      soak->seeks++;
+      break;
+    default:
+      *volume = (r >> 8) % 11 / 10.0f;
+      SourceSetVolume(source, *volume);
+      soak->volume_changes++;
+      break;
+    }
+    soak->next_action += SOAK_ACTION_SECONDS;
+  }
+
+  if (now >= soak->next_sample)
+  {
+    SoakSampleNow(soak, now);
+    soak->next_sample += SOAK_SAMPLE_SECONDS;
+  }
+  return now < soak->end;
+}
+
+static double SoakValue(const SoakSample* s, const SoakMetric* m)
+{
+  if (m->offset == SIZE_MAX)
+    return s->fds;
+  return *(const double*)((const char*)s + m->offset) * m->scale;
+}
+
+/* Least-squares fit of metric m over samples [from, count); false if too few to tell */
+static bool SoakTrend(const SoakTest* soak, size_t from, const SoakMetric* m, double* start,
+                      double* rise)
+{
+  size_t n = soak->sample_count - from;
+  if (soak->sample_count <= from || n < 4)
+    return false;
+  double st = 0, sv = 0, stt = 0, stv = 0;
+  for (size_t i = from; i < soak->sample_count; i++)
+  {
+    double t = soak->samples[i].t, v = SoakValue(&soak->samples[i], m);
+    st += t;
+    sv += v;
+    stt += t * t;
+    stv += t * v;
+  }
+  double denom = n * stt - st * st;
+  double slope = denom > 0 ? (n * stv - st * sv) / denom : 0.0;
+  double t0    = soak->samples[from].t;
+  double t1    = soak->samples[soak->sample_count - 1].t;
+  *start       = (sv - slope * st) / n + slope * t0;
+  *rise        = slope * (t1 - t0);
+  return true;
+}
+
+/* Writes the report; returns the number of metrics flagged as rising */
+int SoakReport(SoakTest* soak, const char* path, double now)
+{
+  atomic_store(&timingEnabled, false);
+  FILE* f = fopen(path, "w");
+  if (f == NULL)
+  {
+    printf("[rAVen] Cannot write soak report %s: %s\n", path, strerror(errno));
+    f = stdout;
+  }
+
+  fprintf(f, "rAVen soak report\n\n");
+  fprintf(f, "duration        %.1f min\n", (now - soak->start) / 60.0);
+  fprintf(f, "track loads     %u\n", soak->loads);
+  fprintf(f, "seeks           %u\n", soak->seeks);
+  fprintf(f, "mode switches   %u\n", soak->mode_switches);
+  fprintf(f, "volume changes  %u\n\n", soak->volume_changes);
+
+  fprintf(f, "%8s %9s %5s %7s %9s %9s %9s %9s %9s %9s\n", "t (s)", "rss (MB)", "fds", "tracks",
+          "cb p50", "cb p99", "cb max", "frm p50", "frm p99", "frm max");
+  for (size_t i = 0; i < soak->sample_count; i++)
+  {
+    const SoakSample* s = &soak->samples[i];
+    fprintf(f, "%8.0f %9.1f %5d %7u %7.0fus %7.0fus %7.0fus %7.2fms %7.2fms %7.2fms\n", s->t,
+            s->rss_mb, s->fds, s->tracks, s->callback_p50 * 1e6, s->callback_p99 * 1e6,
+            s->callback_max * 1e6, s->frame_p50 * 1e3, s->frame_p99 * 1e3, s->frame_max * 1e3);
+  }
+
+  size_t from   = soak->sample_count / 4; // warm-up
+  int    rising = 0;
+  fprintf(f, "\ntrends (least squares over samples %zu..%zu)\n", from, soak->sample_count);
+  for (size_t i = 0; i < ARRAY_LEN(soakMetrics); i++)
+  {
+    const SoakMetric* m = &soakMetrics[i];
+    double            start, rise;
+    if (!SoakTrend(soak, from, m, &start, &rise))
+    {
+      fprintf(f, "  %-13s too few samples, run longer\n", m->name);
+      continue;
+    }
+    bool flagged = rise > m->abs_rise && rise > m->rel_rise * fabs(start);
+    rising += flagged;
+    fprintf(f, "  %-13s %10.2f -> %10.2f %-2s  (%+.1f%%)  %s\n", m->name, start, start + rise,
+            m->unit, start != 0.0 ? 100.0 * rise / fabs(start) : 0.0,
+            flagged ? "RISING" : "ok");
+  }
+  fprintf(f, "\n%s\n", rising ? "FAIL: upward trend detected" : "PASS");
+  if (f != stdout)
+  {
+    fclose(f);
+    printf("[rAVen] Soak report written to %s: %s\n", path, rising ? "upward trend" : "pass");
+  }
+
+  for (size_t i = 0; i < soak->track_count; i++)
+    free(soak->tracks[i]);
+  free(soak->tracks);
+  free(soak->samples);
+  return rising;
+}
+
+int main(int argc, char* argv[])
+{
+  /******************************
+   * @SIGNAL DECLS
+   ******************************/
+
+  signal(SIGABRT, rAVen_sig_abrt);
+
+  Startup startup = {.start = now_seconds()};
+
+  const int screenWidth  = 1280;
+  const int screenHeight = 720;
+
+  if (parse_args(argc, argv) != 0)
   {
-    printf(" [rAVen]\nNo arguments provided.\n");
     return 1;
   }
 
-  InitWindow(screenWidth, screenHeight, "rAVen");
-  SetTargetFPS(60);
+  InitDecimationFilter();
+  if (bench_mode)
+  {
+    return run_benchmark();
+  }
+  if (replayDir != NULL)
+  {
+    return run_replay(replayDir);
+  }
 
-  InitAudioDevice();
-  Music         music    = LoadMusicStream(selected_song);
+  // Before the audio device exists, so the feed is complete before the first frame
+  if (shmName != NULL && ShmFeedOpen(shmName) != 0)
+  {
+    shmName = NULL; // keep running without the feed
+  }
+
+  MediaSource   source   = {0};
   MusicMetadata metadata = {0};
-  extract_metadata(selected_song, &metadata);
-  assert(music.stream.sampleSize == 32);
-  assert(music.stream.channels == 2);
+  StartupBegin(&startup, &source, &metadata);
+
+  SetConfigFlags(FLAG_VSYNC_HINT); // see @RENDER PACING
+  InitWindow(screenWidth, screenHeight, "rAVen");
+  int displayFps = DisplayRefreshRate();
+  SetFramePace(displayFps);
+  startup.window = now_seconds();
+
+  Font font = StartupFinish(&startup);
+  if (startup.closed || startup.audio_status != 0)
+  {
+    if (startupStats && !startup.closed)
+      StartupReport(&startup);
+    SourceUnload(&source);
+    CloseAudioDevice();
+    ShmFeedClose();
+    CloseWindow();
+    return startup.closed ? 0 : 1;
+  }
 
   float currentVolume = 0.8f;          // Volume control (initially set to full)
   float lastVolume    = currentVolume; // Used for toggling mute/unmute state
   bool  isMuted       = false;
 
-  SetMusicVolume(music, currentVolume);
-  PlayMusicStream(music);
-  AttachAudioStreamProcessor(music.stream, callback);
+  SourceSetVolume(&source, currentVolume);
+
+  if (soakMinutes > 0.0 &&
+      !SoakStart(&soakTest, soakMinutes, pcmPath == NULL ? selected_song : NULL, now_seconds()))
+  {
+    SourceUnload(&source);
+    CloseAudioDevice();
+    ShmFeedClose();
+    CloseWindow();
+    return 1;
+  }
+  if (libraryRoot != NULL)
+  {
+    LibraryStart(&libraryScanner, &libraryView, libraryRoot);
+  }
 
-  Font            font    = LoadFontEx("resources/fonts/monogram.ttf", 24, NULL, 0);
   RenderTexture2D overlay = LoadRenderTexture(screenWidth, screenHeight);
 
   // Button properties for the info button
@@ -656,26 +5793,72 @@ int main(int argc, char* argv[])
   Rectangle helpButton = {screenWidth - 100, 80, 60, 30};
   bool      showInfo   = false; // Toggle to display info box
   bool      showHelp   = false;
+  bool      showMeters = true; // loudness / level meters (see @LOUDNESS METERING)
+
+  AnalysisFrame frame         = {0}; // last spectrum read from the audio thread
+  uint32_t      lastBeatCount = 0;
+  float         beatPulse     = 0.0f; // 1 on a beat, decays between beats
+  double        pulseTime     = 0.0;  // frameStart beatPulse was last decayed to
+
+  QualityGovernor governor = {.enabled = true, .budget = 1.0f / displayFps};
+
+  bool   eventWaiting = false;
+  double lastDraw     = 0.0; // frameStart of the last drawn frame
+  int    lastSecond   = -1;
+
+  UiPanel titlePanel = {0}, timePanel = {0}, hudPanel = {0}, tempoPanel = {0};
+  UiPanel buttonPanel = {0}, infoPanel = {0}, helpPanel = {0}, meterPanel = {0};
+  UiPanel libraryPanel = {0};
+
+  GeometryPipelineStart(&geometryPipeline);
 
   while (!WindowShouldClose())
   {
-    UpdateMusicStream(music);
+    double frameStart = now_seconds();
+    bool   inputSeen  = InputActivity();
+    SourceUpdate(&source);
+    if (startupStats)
+    {
+      StartupReport(&startup);
+    }
+    if (soakTest.active && !SoakStep(&soakTest, &source, &metadata, &currentVolume, frameStart))
+    {
+      break;
+    }
+
+    // While the library browser is open it takes the keyboard (see @MUSIC LIBRARY)
+    bool libraryChanged = LibraryRefresh(&libraryView, &libraryScanner);
+    if (libraryScanner.started && IsKeyPressed(KEY_TAB))
+    {
+      LibraryBrowserToggle(&libraryBrowser);
+    }
+    else if (libraryBrowser.open)
+    {
+      const LibraryRecord* pick = LibraryBrowserInput(&libraryBrowser, &libraryView);
+      if (pick != NULL)
+      {
+        snprintf(selected_song, sizeof(selected_song), "%s", pick->path);
+        SourceLoadFile(&source, selected_song);
+        SourceSetVolume(&source, currentVolume);
+        metadata = pick->metadata; // probed when it was indexed
+      }
+    }
 
-    if (IsKeyPressed(KEY_SPACE))
+    if (ShortcutPressed(KEY_SPACE))
     {
-      if (IsMusicStreamPlaying(music))
+      if (SourceIsPlaying(&source))
       {
-        PauseMusicStream(music);
+        SourcePause(&source);
       }
       else
       {
-        ResumeMusicStream(music);
+        SourceResume(&source);
       }
     }
-    if (IsKeyPressed(KEY_Q))
+    if (ShortcutPressed(KEY_Q))
     {
       break;
-      UnloadMusicStream(music);
+      SourceUnload(&source);
       CloseAudioDevice();
       CloseWindow();
       return 0;
@@ -683,20 +5866,16 @@ int main(int argc, char* argv[])
 
     if (IsFileDropped())
     {
-      PauseMusicStream(music);
+      SourcePause(&source);
       FilePathList droppedFiles = LoadDroppedFiles();
       printf("File dropped\n");
       if (droppedFiles.count > 0)
       {
         const char* file_path = droppedFiles.paths[0];
         printf("%s", droppedFiles.paths[0]);
-        StopMusicStream(music);
-        UnloadMusicStream(music);
-        music = LoadMusicStream(file_path);
-        PlayMusicStream(music);
-        SetMusicVolume(music, currentVolume);
+        SourceLoadFile(&source, file_path);
+        SourceSetVolume(&source, currentVolume);
         extract_metadata(file_path, &metadata);
-        AttachAudioStreamProcessor(music.stream, callback);
       }
       UnloadDroppedFiles(droppedFiles);
     }
@@ -708,23 +5887,20 @@ int main(int argc, char* argv[])
     }
 
     // Press 'F' key to open the file chooser
-    if (IsKeyPressed(KEY_F))
+    if (ShortcutPressed(KEY_F))
     {
-      PauseMusicStream(music);
+      SourcePause(&source);
       OpenFileDialog();
       if (is_song_file(selected_song))
       {
-        UnloadMusicStream(music);
-        music = LoadMusicStream(selected_song);
-        PlayMusicStream(music);
-        SetMusicVolume(music, currentVolume);
+        SourceLoadFile(&source, selected_song);
+        SourceSetVolume(&source, currentVolume);
         extract_metadata(selected_song, &metadata);
-        AttachAudioStreamProcessor(music.stream, callback);
       }
       else
       {
         printf("NOT A VALID SONG FILE\n");
-        ResumeMusicStream(music);
+        SourceResume(&source);
       }
     }
     if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && IsMouseOverRectangle(helpButton))
@@ -733,42 +5909,145 @@ int main(int argc, char* argv[])
     }
 
     // Volume controls
-    if (IsKeyPressed(KEY_UP))
+    if (ShortcutPressed(KEY_UP))
     {
       currentVolume += 0.1f;
       if (currentVolume > 1.0f)
         currentVolume = 1.0f; // Max volume
-      SetMusicVolume(music, currentVolume);
+      SourceSetVolume(&source, currentVolume);
       isMuted = false;
     }
-    if (IsKeyPressed(KEY_DOWN))
+    if (ShortcutPressed(KEY_DOWN))
     {
       currentVolume -= 0.1f;
       if (currentVolume < 0.0f)
         currentVolume = 0.0f; // Min volume (mute)
-      SetMusicVolume(music, currentVolume);
+      SourceSetVolume(&source, currentVolume);
       isMuted = false;
     }
-    if (IsKeyPressed(KEY_V))
+    if (ShortcutPressed(KEY_LEFT))
+    {
+      SourceSeek(&source, SourceTimePlayed(&source) - SEEK_STEP_SECONDS);
+    }
+    if (ShortcutPressed(KEY_RIGHT))
+    {
+      SourceSeek(&source, SourceTimePlayed(&source) + SEEK_STEP_SECONDS);
+    }
+    if (ShortcutPressed(KEY_V))
     {
       SwitchVisualizationModeForward();
     }
-    if (IsKeyPressed(KEY_B))
+    if (ShortcutPressed(KEY_B))
     {
       SwitchVisualizationModeBackward();
     }
-    if (IsKeyPressed(KEY_M))
+    if (ShortcutPressed(KEY_G))
+    {
+      governor.enabled = !governor.enabled;
+      if (!governor.enabled)
+      {
+        governor.level = 0; // back to full quality when taking manual control
+        atomic_store(&quality_level, 0);
+      }
+    }
+    if (ShortcutPressed(KEY_L))
+    {
+      showMeters = !showMeters;
+    }
+    if (ShortcutPressed(KEY_LEFT_BRACKET))
+    {
+      avOffsetMs -= AV_OFFSET_STEP_MS;
+    }
+    if (ShortcutPressed(KEY_RIGHT_BRACKET))
+    {
+      avOffsetMs += AV_OFFSET_STEP_MS;
+    }
+    if (ShortcutPressed(KEY_E))
+    {
+      atomic_store(&requested_engine, (atomic_load(&requested_engine) + 1) % NUM_ENGINES);
+    }
+    if (ShortcutPressed(KEY_D))
+    {
+      int d = atomic_load(&requested_decimation);
+      atomic_store(&requested_decimation, d >= 8 ? 1 : d * 2); // off -> 2x -> 4x -> 8x
+    }
+    if (ShortcutPressed(KEY_M))
     {
       isMuted = !isMuted;
       if (isMuted)
       {
-        SetMusicVolume(music, 0.0);
+        SourceSetVolume(&source, 0.0);
       }
       else
       {
-        SetMusicVolume(music, currentVolume);
+        SourceSetVolume(&source, currentVolume);
+      }
+    }
+
+    // Pick the frame that is audible when this one reaches the screen: one frame from now,
+    // through the geometry pipeline (see @LATENCY COMPENSATION, @GEOMETRY PIPELINE)
+    AnalysisFrame latest;
+    bool          spectrumChanged = false;
+    double        latency         = atomic_load(&output_latency) + avOffsetMs / 1000.0;
+    latency -= 1.0 / displayFps;
+    if (AnalysisReadAudible(now_seconds(), latency, &latest)) // keeps the previous frame on a race
+    {
+      spectrumChanged = SpectrumChanged(&frame, &latest);
+      frame           = latest;
+    }
+    // GetFrameTime() only covers the last drawn frame, not loops that skipped drawing
+    beatPulse *= expf(-8.0f * (float)(frameStart - pulseTime));
+    pulseTime  = frameStart;
+    if (frame.beat_count != lastBeatCount)
+    {
+      lastBeatCount = frame.beat_count;
+      beatPulse     = 1.0f;
+    }
+
+    // Idle-aware rendering (see @IDLE-AWARE RENDERING)
+    bool playing = SourceIsPlaying(&source);
+    int  second  = (int)SourceTimePlayed(&source);
+    if (idleRendering)
+    {
+      bool hidden  = IsWindowMinimized() || IsWindowHidden();
+      bool changed = spectrumChanged || inputSeen || second != lastSecond || beatPulse > 0.01f ||
+                     (libraryBrowser.open && libraryChanged);
+
+      if (playing == eventWaiting)
+      {
+        // Paused: sleep until input arrives. Playing: never block, the stream needs feeding
+        eventWaiting = !playing;
+        if (eventWaiting)
+          EnableEventWaiting();
+        else
+          DisableEventWaiting();
+      }
+
+      // Only the drawing is throttled: a loop paced at IDLE_FPS would call SourceUpdate()
+      // less often than the stream's buffers drain and make the audio stutter
+      bool throttled = playing && !IsWindowFocused() && frameStart - lastDraw < 1.0 / IDLE_FPS;
+
+      if (hidden || (playing && (!changed || throttled)))
+      {
+        PollInputEvents(); // EndDrawing() is skipped, so poll input ourselves
+        if (!eventWaiting)
+          WaitTime(IDLE_POLL_SECONDS);
+        continue;
       }
     }
+    lastSecond = second;
+    lastDraw   = frameStart;
+
+    const QualityLevel* quality = &qualityLevels[governor.level];
+    drawDecorations             = quality->decorations;
+    drawSmoothing               = quality->smoothing;
+
+    // Take the geometry built while the last frame was submitted and start on this one's
+    // (see @GEOMETRY PIPELINE)
+    const FrameGeometry* geometry = GeometryAcquire(&geometryPipeline);
+    GeometryInput        next     = {frame,       beatPulse,       screenWidth,  screenHeight,
+                                     currentMode, drawDecorations, drawSmoothing, GetFrameTime()};
+    GeometryRequest(&geometryPipeline, &next);
 
     BeginDrawing();
     ClearBackground(BLACK);
@@ -789,72 +6068,244 @@ int main(int argc, char* argv[])
      * optimal performance and actually looked very cool, overall this gave
      * the rAVen an actual AV experience.
      *
-     * size_t m represents the frequency bands that will be visualized, so instead
-     * of iterating over N (which is a large number), we visualize an audio freq
-     * range instead
+     * frame.band_count represents the frequency bands that will be visualized, so
+     * instead of iterating over N (which is a large number), we visualize an audio
+     * freq range instead (see @BAND LAYOUT, the bands are built in callback())
      *
-     * I got step = 1.06f from an article online on conversion of frequencies to
-     * visualizable audio
+     * I got BAND_STEP = 1.06f from an article online on conversion of frequencies
+     * to visualizable audio
      *
      ****************************************************************************/
-    size_t m    = 0;
-    float  step = 1.06f;
-    for (float f = 20.0f; f < N; f *= step)
-    {
-      m++;
-    }
-    float cell_width = (float)screenWidth / m;
-    handleVisualization(cell_width, screenHeight, screenWidth, m);
-
-    // Draw song title
-    const char* mainTitle = "rAVen";
-    Vector2     titleSize = MeasureTextEx(font, mainTitle, 40, 2);
-    DrawTextEx(font, mainTitle, (Vector2){screenWidth / 2 - titleSize.x / 2, 20}, 40, 2,
-               GRUVBOX_BLUE);
-
-    // Draw song details
-    float totalDuration = GetMusicTimeLength(music);
-    float currentTime   = GetMusicTimePlayed(music);
-
-    char timeBuffer[100];
-    snprintf(timeBuffer, sizeof(timeBuffer), "%.2f / %.2f sec", currentTime, totalDuration);
-    Vector2 detailsSize = MeasureTextEx(font, timeBuffer, 20, 1);
-    DrawRectangle(0, screenHeight - 40, screenWidth, 40, ColorAlpha(BLACK, 0.7f));
-    DrawTextEx(font, timeBuffer, (Vector2){screenWidth / 2 - detailsSize.x / 2, screenHeight - 30},
-               20, 1, WHITE);
-
-    // Draw play/pause status
-    const char* status = IsMusicStreamPlaying(music) ? "Playing" : "Paused";
-    DrawTextEx(font, status, (Vector2){10, 10}, 20, 1,
-               IsMusicStreamPlaying(music) ? GRUVBOX_GREEN : GRUVBOX_RED);
-
-    // Draw volume level
-    char volumeBuffer[50];
-    snprintf(volumeBuffer, sizeof(volumeBuffer), "Volume: %.0f%% %s", currentVolume * 100, isMuted ? "!" : "");
-    DrawTextEx(font, volumeBuffer, (Vector2){10, 40}, 20, 1, GRUVBOX_AQUA);
-
-    // Draw info button
-    DrawRectangleRec(infoButton, showInfo ? GRUVBOX_ORANGE : GRUVBOX_PURPLE);
-    DrawTextEx(font, "INFO", (Vector2){infoButton.x + 10, infoButton.y + 10}, 20, 1, WHITE);
-    DrawRectangleRec(helpButton, showHelp ? GRUVBOX_ORANGE : GRUVBOX_PURPLE);
-    DrawTextEx(font, "?", (Vector2){helpButton.x + 15, helpButton.y + 5}, 20, 1, WHITE);
+    SubmitGeometry(geometry);
+
+    // Retained UI layer (see @RETAINED UI)
+    int titleKey = 0;
+    if (UiPanelBegin(&titlePanel, (Rectangle){screenWidth / 2 - 150, 15, 300, 50}, &titleKey,
+                     sizeof(titleKey)))
+    {
+      // Draw song title
+      const char* mainTitle = "rAVen";
+      Vector2     titleSize = MeasureTextEx(font, mainTitle, 40, 2);
+      DrawTextEx(font, mainTitle, (Vector2){screenWidth / 2 - titleSize.x / 2, 20}, 40, 2,
+                 GRUVBOX_BLUE);
+      UiPanelEnd(&titlePanel);
+    }
+    UiPanelDraw(&titlePanel, 1.0f);
+
+    // Draw song details, re-rendered on second boundaries only
+    TimeKey timeKey = {(int)SourceTimePlayed(&source), (int)SourceTimeLength(&source)};
+    if (UiPanelBegin(&timePanel, (Rectangle){0, screenHeight - 40, screenWidth, 40}, &timeKey,
+                     sizeof(timeKey)))
+    {
+      char timeBuffer[100];
+      if (timeKey.total > 0)
+        snprintf(timeBuffer, sizeof(timeBuffer), "%d:%02d / %d:%02d", timeKey.played / 60,
+                 timeKey.played % 60, timeKey.total / 60, timeKey.total % 60);
+      else
+        snprintf(timeBuffer, sizeof(timeBuffer), "%d:%02d (live)", timeKey.played / 60,
+                 timeKey.played % 60);
+      Vector2 detailsSize = MeasureTextEx(font, timeBuffer, 20, 1);
+      DrawRectangle(0, screenHeight - 40, screenWidth, 40, ColorAlpha(BLACK, 0.7f));
+      DrawTextEx(font, timeBuffer,
+                 (Vector2){screenWidth / 2 - detailsSize.x / 2, screenHeight - 30}, 20, 1, WHITE);
+      UiPanelEnd(&timePanel);
+    }
+    UiPanelDraw(&timePanel, 1.0f);
+
+    HudKey hudKey = {playing,
+                     (int)(currentVolume * 100 + 0.5f),
+                     isMuted,
+                     atomic_load(&requested_engine),
+                     atomic_load(&requested_decimation),
+                     governor.level,
+                     governor.enabled,
+                     source.kind == SOURCE_PCM,
+                     source.kind == SOURCE_PCM ? (int)atomic_load(&source.pcm.overruns) : 0,
+                     source.kind == SOURCE_PCM ? (int)source.pcm.underruns : 0,
+                     (int)(atomic_load(&output_latency) * 1000 + 0.5f),
+                     avOffsetMs};
+    if (UiPanelBegin(&hudPanel, (Rectangle){0, 0, 320, 220}, &hudKey, sizeof(hudKey)))
+    {
+      // Draw play/pause status
+      const char* status = playing ? "Playing" : "Paused";
+      DrawTextEx(font, status, (Vector2){10, 10}, 20, 1, playing ? GRUVBOX_GREEN : GRUVBOX_RED);
+
+      // Draw volume level
+      char volumeBuffer[50];
+      snprintf(volumeBuffer, sizeof(volumeBuffer), "Volume: %d%% %s", hudKey.volume,
+               isMuted ? "!" : "");
+      DrawTextEx(font, volumeBuffer, (Vector2){10, 40}, 20, 1, GRUVBOX_AQUA);
+
+      // Draw analysis engine (and bass decimation factor for the FFT engine)
+      char engineBuffer[50];
+      if (hudKey.engine == ENGINE_RESONATOR)
+        snprintf(engineBuffer, sizeof(engineBuffer), "Engine: resonators");
+      else if (hudKey.decimation > 1)
+        snprintf(engineBuffer, sizeof(engineBuffer), "Engine: FFT, bass %dx", hudKey.decimation);
+      else
+        snprintf(engineBuffer, sizeof(engineBuffer), "Engine: FFT");
+      DrawTextEx(font, engineBuffer, (Vector2){10, 70}, 20, 1, GRUVBOX_YELLOW);
+
+      // Draw quality level picked by the governor
+      char qualityBuffer[50];
+      snprintf(qualityBuffer, sizeof(qualityBuffer), "Quality: %s%s", quality->name,
+               governor.enabled ? " (auto)" : "");
+      DrawTextEx(font, qualityBuffer, (Vector2){10, 130}, 20, 1, GRUVBOX_PURPLE);
+
+      // Draw output latency compensation (see @LATENCY COMPENSATION)
+      char syncBuffer[64];
+      snprintf(syncBuffer, sizeof(syncBuffer), "A/V sync: %d ms auto %+d ms", hudKey.latency_ms,
+               hudKey.offset_ms);
+      DrawTextEx(font, syncBuffer, (Vector2){10, 160}, 20, 1, GRUVBOX_BLUE);
+
+      // Draw PCM input health for live streams
+      if (hudKey.live)
+      {
+        char pcmBuffer[64];
+        snprintf(pcmBuffer, sizeof(pcmBuffer), "PCM: %d overruns, %d underruns", hudKey.overruns,
+                 hudKey.underruns);
+        DrawTextEx(font, pcmBuffer, (Vector2){10, 190}, 20, 1,
+                   hudKey.overruns || hudKey.underruns ? GRUVBOX_RED : GRUVBOX_FG);
+      }
+      UiPanelEnd(&hudPanel);
+    }
+    UiPanelDraw(&hudPanel, 1.0f);
+
+    // Draw tempo, flashing on every detected beat (the flash is only a composite tint)
+    int bpmKey = (int)(frame.bpm + 0.5f);
+    if (UiPanelBegin(&tempoPanel, (Rectangle){0, 95, 200, 30}, &bpmKey, sizeof(bpmKey)))
+    {
+      char bpmBuffer[50];
+      if (bpmKey > 0)
+        snprintf(bpmBuffer, sizeof(bpmBuffer), "BPM: %d", bpmKey);
+      else
+        snprintf(bpmBuffer, sizeof(bpmBuffer), "BPM: --");
+      DrawTextEx(font, bpmBuffer, (Vector2){10, 100}, 20, 1, GRUVBOX_ORANGE);
+      UiPanelEnd(&tempoPanel);
+    }
+    UiPanelDraw(&tempoPanel, 0.5f + 0.5f * beatPulse);
+
+    // Draw loudness and level meters under the buttons
+    if (showMeters)
+    {
+      const LoudnessReading* lr = &frame.loudness;
+
+      MeterKey meterKey = {MeterTenths(lr->momentary),  MeterTenths(lr->short_term),
+                           MeterTenths(lr->integrated), MeterTenths(lr->rms),
+                           MeterTenths(lr->true_peak),  MeterTenths(lr->true_peak_max)};
+      if (UiPanelBegin(&meterPanel, (Rectangle){screenWidth - 250, 120, 240, 200}, &meterKey,
+                       sizeof(meterKey)))
+      {
+        float x = screenWidth - 240;
+        DrawRectangle(screenWidth - 250, 120, 240, 200, ColorAlpha(GRUVBOX_BG, 0.6f));
+        DrawMeterLine(font, x, 128, "M", meterKey.momentary, "LUFS", GRUVBOX_GREEN);
+        DrawMeterLine(font, x, 160, "S", meterKey.short_term, "LUFS", GRUVBOX_AQUA);
+        DrawMeterLine(font, x, 192, "I", meterKey.integrated, "LUFS", GRUVBOX_YELLOW);
+        DrawMeterLine(font, x, 224, "RMS", meterKey.rms, "dBFS", GRUVBOX_BLUE);
+        // Above -1 dBTP is over the usual delivery ceiling
+        DrawMeterLine(font, x, 256, "TP", meterKey.true_peak, "dBTP",
+                      meterKey.true_peak > -10 ? GRUVBOX_RED : GRUVBOX_ORANGE);
+
+        char maxBuffer[48];
+        if (meterKey.true_peak_max == INT16_MIN)
+          snprintf(maxBuffer, sizeof(maxBuffer), "TP max  -inf dBTP");
+        else
+          snprintf(maxBuffer, sizeof(maxBuffer), "TP max %5.1f dBTP",
+                   meterKey.true_peak_max / 10.0f);
+        DrawTextEx(font, maxBuffer, (Vector2){x, 288}, 20, 1,
+                   meterKey.true_peak_max > -10 ? GRUVBOX_RED : GRUVBOX_FG);
+        UiPanelEnd(&meterPanel);
+      }
+      UiPanelDraw(&meterPanel, 1.0f);
+    }
+
+    ButtonKey buttonKey = {showInfo, showHelp};
+    if (UiPanelBegin(&buttonPanel, (Rectangle){screenWidth - 100, 20, 100, 90}, &buttonKey,
+                     sizeof(buttonKey)))
+    {
+      // Draw info button
+      DrawRectangleRec(infoButton, showInfo ? GRUVBOX_ORANGE : GRUVBOX_PURPLE);
+      DrawTextEx(font, "INFO", (Vector2){infoButton.x + 10, infoButton.y + 10}, 20, 1, WHITE);
+      DrawRectangleRec(helpButton, showHelp ? GRUVBOX_ORANGE : GRUVBOX_PURPLE);
+      DrawTextEx(font, "?", (Vector2){helpButton.x + 15, helpButton.y + 5}, 20, 1, WHITE);
+      UiPanelEnd(&buttonPanel);
+    }
+    UiPanelDraw(&buttonPanel, 1.0f);
 
     // Display info box if the button is toggled
     if (showInfo)
     {
-      DrawSpaceTheme(font, music, &metadata);
+      TrackKey trackKey;
+      memset(&trackKey, 0, sizeof(trackKey));
+      trackKey.metadata   = metadata;
+      trackKey.sampleRate = SourceStream(&source).sampleRate;
+      trackKey.channels   = SourceStream(&source).channels;
+      trackKey.sampleSize = SourceStream(&source).sampleSize;
+      if (UiPanelBegin(&infoPanel, (Rectangle){0, 90, 480, 240}, &trackKey, sizeof(trackKey)))
+      {
+        DrawSpaceTheme(font, SourceStream(&source), &metadata);
+        UiPanelEnd(&infoPanel);
+      }
+      UiPanelDraw(&infoPanel, 1.0f);
     }
     if (showHelp)
     {
-      DrawHelpBox(showHelp, font, screenHeight, screenWidth);
+      int helpKey[2] = {screenWidth, screenHeight};
+      if (UiPanelBegin(&helpPanel, (Rectangle){0, 0, screenWidth, screenHeight}, helpKey,
+                       sizeof(helpKey)))
+      {
+        DrawHelpBox(showHelp, font, screenHeight, screenWidth);
+        UiPanelEnd(&helpPanel);
+      }
+      UiPanelDraw(&helpPanel, 1.0f);
+    }
+    if (libraryBrowser.open)
+    {
+      LibraryKey libraryKey;
+      memset(&libraryKey, 0, sizeof(libraryKey));
+      libraryKey.generation = libraryView.generation;
+      libraryKey.scanning   = atomic_load(&libraryScanner.scanning);
+      libraryKey.selected   = libraryBrowser.selected;
+      libraryKey.scroll     = libraryBrowser.scroll;
+      libraryKey.matches    = libraryBrowser.match_count;
+      memcpy(libraryKey.filter, libraryBrowser.filter, sizeof(libraryKey.filter));
+      Rectangle box = {(screenWidth - 760) / 2.0f, (screenHeight - 570) / 2.0f, 760, 570};
+      if (UiPanelBegin(&libraryPanel, (Rectangle){0, 0, screenWidth, screenHeight}, &libraryKey,
+                       sizeof(libraryKey)))
+      {
+        DrawLibraryBrowser(&libraryBrowser, &libraryView, font, box, libraryKey.scanning);
+        UiPanelEnd(&libraryPanel);
+      }
+      UiPanelDraw(&libraryPanel, 1.0f);
     }
 
+    double frameWork = now_seconds() - frameStart;
+    GovernorUpdate(&governor, frameWork, atomic_load(&analysis_load));
+    if (soakTest.active)
+      TimingRecord(&frameWorkTimes, frameWork);
     EndDrawing();
   }
 
-  UnloadMusicStream(music);
+  GeometryPipelineStop(&geometryPipeline);
+  UiPanelUnload(&titlePanel);
+  UiPanelUnload(&timePanel);
+  UiPanelUnload(&hudPanel);
+  UiPanelUnload(&tempoPanel);
+  UiPanelUnload(&buttonPanel);
+  UiPanelUnload(&infoPanel);
+  UiPanelUnload(&helpPanel);
+  UiPanelUnload(&meterPanel);
+  UiPanelUnload(&libraryPanel);
+  LibraryStop(&libraryScanner);
+  LibraryViewClose(&libraryView);
+  SourceUnload(&source);
   CloseAudioDevice();
+  ShmFeedClose(); // after the audio thread is gone
   CloseWindow();
 
+  if (soakTest.active && SoakReport(&soakTest, soakReportPath, now_seconds()) > 0)
+  {
+    return 1;
+  }
   return 0;
 }
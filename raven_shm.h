@@ -0,0 +1,112 @@
+#ifndef RAVEN_SHM_H
+#define RAVEN_SHM_H
+
+/*************************************************************
+ *
+ * @SHARED MEMORY SPECTRUM FEED
+ *
+ * rAVen started with --shm[=name] publishes every analysis
+ * frame into a POSIX shared memory object (default
+ * RAVEN_SHM_DEFAULT_NAME) so LED controllers, lighting rigs
+ * etc. can reuse the spectrum instead of capturing and
+ * transforming the audio again.
+ *
+ * This header is the whole contract: include it, shm_open()
+ * the name read-only and mmap() it.
+ *
+ * $LAYOUT (fixed, native endianness, all offsets 8-aligned)
+ *
+ *   offset 0                 RavenShmHeader   (64 bytes)
+ *   offset header_size       RavenShmFrame[slot_count]
+ *
+ * Frame f (0-based) lives in slot f % slot_count. The ring
+ * is overwritten in place; there is no back-pressure, so a
+ * slow reader can never slow rAVen down, it just skips
+ * frames.
+ *
+ * $READER PROTOCOL (seqlock, lock-free, zero-copy)
+ *
+ *   uint64_t n = raven_shm_write_count(hdr);   // frames published
+ *   if (n == 0) nothing yet
+ *   const RavenShmFrame* slot = raven_shm_slot(hdr, n - 1);
+ *   uint64_t s = raven_shm_read_begin(slot);
+ *   if (s != raven_shm_seq_done(n - 1)) -> being rewritten, retry
+ *   ... read slot->bands[] etc. in place ...
+ *   if (!raven_shm_read_end(slot, s))     -> torn read, discard
+ *
+ * Readers must only read: the producer owns every byte.
+ *
+ * $VERSIONING
+ *
+ * magic and version are written last when rAVen starts, so a
+ * reader that sees RAVEN_SHM_MAGIC also sees a complete header.
+ * Layout changes bump RAVEN_SHM_VERSION.
+ *
+ ************************************************************/
+
+#include <stdint.h>
+
+#define RAVEN_SHM_DEFAULT_NAME "/raven-spectrum"
+#define RAVEN_SHM_MAGIC        0x4E564152u // "RAVN" in a little-endian dump
+#define RAVEN_SHM_VERSION      1u
+#define RAVEN_SHM_SLOTS        64u
+#define RAVEN_SHM_BANDS        128u
+
+#define RAVEN_SHM_FLAG_BEAT 0x1u // a beat was detected since the previous frame
+
+typedef struct
+{
+  uint64_t seq;          // 2f + 1 while frame f is being written, 2f + 2 once complete
+  uint64_t frame;        // f
+  uint64_t timestamp_ns; // CLOCK_MONOTONIC at publish time
+  uint32_t band_count;   // valid entries in bands[]
+  uint32_t flags;        // RAVEN_SHM_FLAG_*
+  uint32_t beat_count;   // beats detected since rAVen started
+  float    peak;         // max over bands[]
+  float    bpm;          // 0 while no tempo is established
+  float    onset;        // spectral flux of this frame
+  float    bands[RAVEN_SHM_BANDS]; // log-spaced band magnitudes, lowest first
+} RavenShmFrame;
+
+typedef struct
+{
+  uint32_t magic;        // RAVEN_SHM_MAGIC
+  uint32_t version;      // RAVEN_SHM_VERSION
+  uint32_t header_size;  // offset of slot 0
+  uint32_t slot_size;    // sizeof(RavenShmFrame)
+  uint32_t slot_count;   // RAVEN_SHM_SLOTS
+  uint32_t bands_max;    // RAVEN_SHM_BANDS
+  uint32_t sample_rate;  // of the analyzed stream
+  uint32_t producer_pid; // pid of the rAVen instance writing
+  uint64_t write_count;  // frames published so far
+  uint8_t  reserved[24];
+} RavenShmHeader;
+
+_Static_assert(sizeof(RavenShmHeader) == 64, "RavenShmHeader layout changed");
+_Static_assert(sizeof(RavenShmFrame) == 48 + 4 * RAVEN_SHM_BANDS, "RavenShmFrame layout changed");
+
+static inline uint64_t raven_shm_write_count(const RavenShmHeader* hdr)
+{
+  return __atomic_load_n(&hdr->write_count, __ATOMIC_ACQUIRE);
+}
+
+static inline const RavenShmFrame* raven_shm_slot(const RavenShmHeader* hdr, uint64_t frame)
+{
+  const uint8_t* base = (const uint8_t*)hdr + hdr->header_size;
+  return (const RavenShmFrame*)(base + (frame % hdr->slot_count) * hdr->slot_size);
+}
+
+static inline uint64_t raven_shm_seq_done(uint64_t frame) { return 2 * frame + 2; }
+
+static inline uint64_t raven_shm_read_begin(const RavenShmFrame* slot)
+{
+  return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+}
+
+static inline int raven_shm_read_end(const RavenShmFrame* slot, uint64_t seq)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq;
+}
+
+#endif